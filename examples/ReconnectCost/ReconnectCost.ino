@@ -0,0 +1,93 @@
+/*
+  Measures what a reconnect costs on the device: TLS connect time and the
+  heap it takes. Build with -DDECENTIOT_METRICS=1 (for example
+  build_flags = -DDECENTIOT_METRICS=1 in platformio.ini).
+
+  Every minute the sketch drops the MQTT session and lets the library
+  reconnect. On ESP8266 the second and later handshakes resume the TLS
+  session when the broker supports it, so they should be much cheaper than
+  the first. On ESP32 every reconnect is a full handshake: the Arduino core
+  does not expose mbedTLS session resumption.
+*/
+#include <DecentIoT.h>
+#if defined(ESP8266)
+#include <ESP8266WiFi.h>
+#include <umm_malloc/umm_malloc.h>
+#else
+#include <WiFi.h>
+#endif
+
+#if !DECENTIOT_METRICS
+#error "Build with -DDECENTIOT_METRICS=1 to record handshake times"
+#endif
+
+#define MQTT_BROKER "your-broker.hivemq.cloud"
+#define MQTT_PORT 8883
+#define MQTT_USERNAME "your-mqtt-username"
+#define MQTT_PASSWORD "your-mqtt-password"
+#define PROJECT_ID "my-iot-project"
+#define USER_ID "user123"
+#define DEVICE_ID "reconnect-test"
+#define WIFI_SSID "your-wifi-ssid"
+#define WIFI_PASS "your-wifi-password"
+
+#define CYCLE_MS 60000
+
+static unsigned long lastCycle = 0;
+static uint32_t heapBefore = 0;
+static bool waiting = false;
+static int cycle = 0;
+
+// Lowest free heap seen since boot. The handshake is by far the deepest
+// point of a reconnect, so heapBefore minus this is its peak use.
+static uint32_t lowestFreeHeap()
+{
+#if defined(ESP32)
+  return ESP.getMinFreeHeap();
+#elif defined(UMM_STATS_FULL)
+  return umm_free_heap_size_lw();
+#else
+  return ESP.getFreeHeap(); // no low-water mark without UMM_STATS_FULL
+#endif
+}
+
+void setup()
+{
+  Serial.begin(115200);
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  while (WiFi.status() != WL_CONNECTED)
+  {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println("\nWiFi connected!");
+
+  heapBefore = ESP.getFreeHeap();
+  waiting = true;
+  DecentIoT.begin(MQTT_BROKER, MQTT_PORT, MQTT_USERNAME, MQTT_PASSWORD, PROJECT_ID, USER_ID, DEVICE_ID);
+}
+
+void loop()
+{
+  DecentIoT.run();
+
+  if (waiting && strcmp(DecentIoT.getStatus(), "connected") == 0)
+  {
+    const DecentIoTStats &stats = DecentIoT.getStats();
+    uint32_t lowest = lowestFreeHeap();
+    Serial.printf("[cycle %d] TLS connect %lu ms, heap before %lu, lowest %lu, peak use %ld bytes\n", cycle,
+                  (unsigned long)stats.tlsHandshake.max, (unsigned long)heapBefore, (unsigned long)lowest,
+                  (long)heapBefore - (long)lowest);
+    waiting = false;
+    lastCycle = millis();
+  }
+
+  if (!waiting && millis() - lastCycle >= CYCLE_MS)
+  {
+    cycle++;
+    DecentIoT.resetStats();
+    heapBefore = ESP.getFreeHeap();
+    waiting = true;
+    DecentIoT.disconnect(); // run() reconnects after the backoff delay
+  }
+}
@@ -0,0 +1,444 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Host benchmarks for the hot paths: time per call and heap allocations
+// per call, against the in-memory broker; sample block compression;
+// cross-thread throughput and latency of the rings; and fleet reconnects.
+// Usage: decentiot_bench [iterations]
+
+#include "DecentIoT.h"
+#include "DecentIoTMqtt.h"
+#include "DecentIoTRing.h"
+#include "DecentIoTSeries.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::atomic<unsigned long> allocations(0);
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+template <typename Body>
+static void measure(const char *name, unsigned long iterations, Body body)
+{
+    unsigned long startAllocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < iterations; i++)
+        body(i);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    double allocs = (double)(allocations - startAllocations) / iterations;
+    printf("%-24s %10.1f ns/op %8.2f allocs/op\n", name, ns, allocs);
+}
+
+// One more run() after connected() subscribes and drains the queue
+static void runUntilConnected()
+{
+    for (int i = 0; i < 10000 && !DecentIoT.connected(); i++)
+    {
+        hostAdvanceMillis(10);
+        DecentIoT.run();
+    }
+    hostAdvanceMillis(10);
+    DecentIoT.run();
+}
+
+// Time from CONNACK until every receive pin is subscribed. Neither MQTT
+// client waits for SUBACK, so the host measures SUBSCRIBE packets and
+// bytes; the ready time is modelled for a broker that handles one
+// connection's SUBSCRIBEs one after another.
+static const unsigned long kRoundTripMs = 80;
+static const unsigned long kSubscribeMs = 5; // broker time per SUBSCRIBE
+
+static void timeToReady(const char *name, DecentIoTSubscribeMode mode)
+{
+    HostBroker &broker = HostBroker::instance();
+    DecentIoT.setSubscribeMode(mode);
+    broker.drop();
+    broker.subscriptions.clear();
+    broker.record = true;
+    runUntilConnected();
+    broker.record = false;
+
+    size_t bytes = 0;
+    for (const std::string &topic : broker.subscriptions)
+    {
+        size_t remaining = 2 + 2 + topic.size() + 1; // packet id, topic, options (3.1.1)
+        bytes += 1 + (remaining < 128 ? 1 : 2) + remaining;
+    }
+    size_t packets = broker.subscriptions.size();
+    printf("%-24s %4zu SUBSCRIBE %6zu bytes   ready after ~%lu ms\n", name, packets, bytes,
+           kRoundTripMs + packets * kSubscribeMs);
+}
+
+// Reconnect storm: a fleet of clients in this process, all connected to one
+// broker that restarts. The broker is down for kOutageMs and then accepts
+// at most kBrokerAcceptsPerSecond CONNECTs a second, refusing the rest as
+// unavailable. Everything runs on the fake clock, one run() per device
+// every kStormStepMs. Reports when each device was back, counted from the
+// broker's return, and the peak rate of connection attempts it had to take.
+static const unsigned long kOutageMs = 30000;
+static const unsigned long kBrokerAcceptsPerSecond = 50;
+static const unsigned long kStormStepMs = 20;
+
+static void reconnectStorm(const char *name, size_t devices, uint32_t minDelay, uint32_t maxDelay)
+{
+    HostBroker &broker = HostBroker::instance();
+    std::vector<DecentIoTClass *> fleet;
+    for (size_t i = 0; i < devices; i++)
+    {
+        DecentIoTClass *device = new DecentIoTClass();
+        device->setReconnectBackoff(minDelay, maxDelay);
+        device->begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+        fleet.push_back(device);
+    }
+    size_t online = 0;
+    for (int i = 0; i < 1000 && online < devices; i++)
+    {
+        hostAdvanceMillis(kStormStepMs);
+        online = 0;
+        for (DecentIoTClass *device : fleet)
+        {
+            device->run();
+            online += device->connected();
+        }
+    }
+
+    broker.up = false;
+    broker.drop();
+    for (unsigned long elapsed = 0; elapsed < kOutageMs; elapsed += kStormStepMs)
+    {
+        hostAdvanceMillis(kStormStepMs);
+        for (DecentIoTClass *device : fleet)
+            device->run();
+    }
+
+    broker.up = true;
+    broker.connectsPerSecond = kBrokerAcceptsPerSecond;
+    unsigned long restart = millis();
+    unsigned long firstSockets = broker.sockets;
+    unsigned long windowSockets = broker.sockets;
+    unsigned long peakAttempts = 0;
+    std::vector<unsigned long> recovery;
+    std::vector<bool> back(devices, false);
+    for (unsigned long elapsed = 0; recovery.size() < devices && elapsed < 3600000; elapsed += kStormStepMs)
+    {
+        hostAdvanceMillis(kStormStepMs);
+        for (size_t i = 0; i < devices; i++)
+        {
+            fleet[i]->run();
+            if (!back[i] && fleet[i]->connected())
+            {
+                back[i] = true;
+                recovery.push_back(millis() - restart);
+            }
+        }
+        if ((elapsed + kStormStepMs) % 1000 == 0)
+        {
+            peakAttempts = std::max(peakAttempts, broker.sockets - windowSockets);
+            windowSockets = broker.sockets;
+        }
+    }
+    broker.connectsPerSecond = 0;
+    unsigned long attempts = broker.sockets - firstSockets;
+    for (DecentIoTClass *device : fleet)
+        delete device;
+
+    std::sort(recovery.begin(), recovery.end());
+    size_t count = recovery.size();
+    printf("%-24s %4zu/%zu back   min %5.1f s  p50 %5.1f s  p99 %5.1f s  max %5.1f s   %5lu attempts, peak %4lu/s\n",
+           name, count, devices, count ? recovery[0] / 1000.0 : 0.0, count ? recovery[count / 2] / 1000.0 : 0.0,
+           count ? recovery[count * 99 / 100] / 1000.0 : 0.0, count ? recovery[count - 1] / 1000.0 : 0.0, attempts,
+           peakAttempts);
+}
+
+// Bytes on the wire for the same telemetry through the native client: 10
+// pins, 100 retained values each, on full pin topics. Topic aliases are
+// numbered per pin as DecentIoT does, so only each pin's first publish
+// carries its topic.
+static const int kWirePins = 10;
+static const int kWireRounds = 100;
+
+static void wireBytes(const char *name, uint8_t version, uint16_t aliasMax)
+{
+    static WiFiClientSecure unusedSocket;
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker.local", 8883);
+    mqtt.setProtocolVersion(version);
+    const uint8_t connack311[] = {0x20, 2, 0, 0};
+    const uint8_t connack5[] = {0x20, 6, 0, 0, 3, 0x22, (uint8_t)(aliasMax >> 8), (uint8_t)aliasMax};
+    if (version < 5)
+        link.inject(connack311, sizeof(connack311));
+    else
+        link.inject(connack5, sizeof(connack5));
+    if (!mqtt.connect("DecentIoT-1a2b", "user", "pass"))
+    {
+        printf("%-24s could not connect\n", name);
+        return;
+    }
+
+    size_t bytes = 0;
+    for (int round = 0; round < kWireRounds; round++)
+    {
+        for (int pin = 1; pin <= kWirePins; pin++)
+        {
+            char topic[64];
+            char payload[16];
+            snprintf(topic, sizeof(topic), "project/users/uid/datastreams/device/P%d/value", pin);
+            int length = snprintf(payload, sizeof(payload), "%d.%d", 20 + round % 10, pin);
+            link.clearSent();
+            mqtt.publish(topic, reinterpret_cast<const uint8_t *>(payload), length, true, 0, (uint16_t)pin);
+            bytes += link.sent().size();
+        }
+    }
+    size_t publishes = kWirePins * kWireRounds;
+    printf("%-24s %8zu bytes %6.1f bytes/publish\n", name, bytes, (double)bytes / publishes);
+}
+
+// Sample blocks on synthetic traces standing in for recorded ones. Reports
+// bytes per sample against 12 raw bytes (8-byte timestamp, 4-byte value),
+// samples per block, and encode and decode time per sample.
+template <typename T>
+static void seriesBlocks(const char *name, const std::vector<T> &trace, uint32_t periodMs)
+{
+    DecentIoTSeriesEncoder encoder;
+    DecentIoTSeriesReader reader;
+    size_t bytes = 0;
+    size_t blocks = 0;
+    double encodeNs = 0;
+    double decodeNs = 0;
+    volatile T sink = 0;
+    uint32_t t = 0;
+    size_t i = 0;
+    while (i < trace.size())
+    {
+        auto start = std::chrono::steady_clock::now();
+        encoder.reset();
+        while (i < trace.size() && encoder.add(t, trace[i]))
+        {
+            i++;
+            t += periodMs;
+        }
+        size_t length;
+        const uint8_t *block = encoder.finish(1700000000000ULL, true, length);
+        auto encoded = std::chrono::steady_clock::now();
+        uint64_t timestamp;
+        T value;
+        reader.begin(block, length);
+        while (reader.next(timestamp, value))
+            sink = value;
+        auto decoded = std::chrono::steady_clock::now();
+        encodeNs += std::chrono::duration<double, std::nano>(encoded - start).count();
+        decodeNs += std::chrono::duration<double, std::nano>(decoded - encoded).count();
+        bytes += length;
+        blocks++;
+    }
+    (void)sink;
+    double perSample = (double)bytes / trace.size();
+    printf("%-24s %5.2f bytes/sample (%4.1fx raw) %6.1f samples/block   encode %5.1f ns  decode %5.1f ns\n", name,
+           perSample, 12.0 / perSample, (double)trace.size() / blocks, encodeNs / trace.size(),
+           decodeNs / trace.size());
+}
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Producer threads push timestamps through a ring of the library's default
+// size while this thread pops them: ns per item end to end, and push-to-pop
+// latency. Both sides yield when the ring is full or empty, as the network
+// task does, so the numbers include scheduler hand-offs.
+template <typename Ring>
+static void ringThroughput(const char *name, Ring &ring, unsigned producers, unsigned long items)
+{
+    unsigned long perProducer = items / producers + 1;
+    unsigned long total = perProducer * producers;
+    std::vector<uint32_t> latencies;
+    latencies.reserve(total);
+
+    uint64_t start = nowNanos();
+    std::vector<std::thread> threads;
+    for (unsigned p = 0; p < producers; p++)
+    {
+        threads.push_back(std::thread([&ring, perProducer]() {
+            for (unsigned long i = 0; i < perProducer; i++)
+            {
+                while (!ring.push(nowNanos()))
+                    std::this_thread::yield();
+            }
+        }));
+    }
+    while (latencies.size() < total)
+    {
+        uint64_t stamp;
+        if (!ring.pop(stamp))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        latencies.push_back((uint32_t)(nowNanos() - stamp));
+    }
+    double ns = (double)(nowNanos() - start) / total;
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-24s %10.1f ns/item   latency p50 %7u ns  p99 %8u ns  max %9u ns\n", name, ns,
+           latencies[total / 2], latencies[total * 99 / 100], latencies[total - 1]);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+    if (iterations == 0)
+        iterations = 1;
+
+    HostBroker &broker = HostBroker::instance();
+    broker.record = false;
+    WiFi.setStatus(WL_CONNECTED);
+    volatile int sink = 0;
+    DecentIoT.onReceive(P1, [&](const DecentIoTValue &value) { sink = (int)value; });
+    for (int pin = 2; pin <= 50; pin++)
+    {
+        char name[8];
+        snprintf(name, sizeof(name), "P%d", pin);
+        DecentIoT.onReceive(name, [](const DecentIoTValue &) {});
+    }
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runUntilConnected();
+    if (!DecentIoT.connected())
+    {
+        printf("could not connect\n");
+        return 1;
+    }
+
+    measure("write(int)", iterations, [](unsigned long i) { DecentIoT.write(P2, (int)i); });
+    measure("write(float)", iterations, [](unsigned long i) { DecentIoT.write(P3, i * 0.25f); });
+    measure("write(string)", iterations, [](unsigned long) { DecentIoT.write(P4, "status ok"); });
+
+    measure("batch of 4", iterations, [](unsigned long i) {
+        DecentIoT.beginBatch();
+        DecentIoT.add(P5, (int)i);
+        DecentIoT.add(P6, i * 0.5f);
+        DecentIoT.add(P7, true);
+        DecentIoT.add(P8, "text");
+        DecentIoT.commitBatch();
+    });
+
+    const char *topic = "project/users/uid/datastreams/device/P1/value";
+    measure("receive", iterations, [&](unsigned long) { broker.deliver(topic, "1234"); });
+
+    for (int i = 0; i < 32; i++)
+        DecentIoT.schedule(1000 + i, []() {});
+    measure("run() with 32 tasks", iterations, [](unsigned long) {
+        hostAdvanceMillis(1);
+        DecentIoT.run();
+    });
+
+    unsigned long cycles = iterations / 100 + 1;
+    measure("reconnect", cycles, [&](unsigned long) {
+        broker.drop();
+        runUntilConnected();
+    });
+
+    printf("time to ready, 50 receive pins (%lu ms round trip, %lu ms per SUBSCRIBE)\n", kRoundTripMs,
+           kSubscribeMs);
+    timeToReady("  per pin", DECENTIOT_SUBSCRIBE_PER_PIN);
+    timeToReady("  wildcard", DECENTIOT_SUBSCRIBE_WILDCARD);
+
+    printf("PUBLISH bytes, %d pins x %d values\n", kWirePins, kWireRounds);
+    wireBytes("  MQTT 3.1.1", 4, 0);
+    wireBytes("  MQTT 5", 5, 0);
+    wireBytes("  MQTT 5, topic aliases", 5, 16);
+
+    // A temperature every 10 s: slow drift plus sensor noise, 0.1 degree
+    // steps. A 100 Hz integer vibration signal: two tones plus noise.
+    size_t samples = std::max(iterations, 1000UL);
+    std::vector<float> temperature(samples);
+    std::vector<int32_t> vibration(samples);
+    for (size_t i = 0; i < samples; i++)
+    {
+        float drift = 21.0f + 3.0f * sinf(i * 0.0007f);
+        temperature[i] = roundf((drift + (rand() % 5 - 2) * 0.05f) * 10.0f) / 10.0f;
+        vibration[i] = (int32_t)(800 * sinf(i * 0.31f) + 150 * sinf(i * 2.1f)) + rand() % 31 - 15;
+    }
+    printf("sample blocks, %zu samples, %d byte blocks\n", samples, DECENTIOT_SERIES_BLOCK_SIZE);
+    seriesBlocks("  temperature (float)", temperature, 10000);
+    seriesBlocks("  vibration (int)", vibration, 10);
+
+    static DecentIoTSpscRing<uint64_t, 16> spsc; // DECENTIOT_RING_SIZE
+    static DecentIoTMpscRing<uint64_t, DECENTIOT_ISR_RING_SIZE> mpsc;
+    ringThroughput("SPSC ring, 1 producer", spsc, 1, iterations);
+    ringThroughput("MPSC ring, 1 producer", mpsc, 1, iterations);
+    ringThroughput("MPSC ring, 4 producers", mpsc, 4, iterations);
+
+    size_t devices = std::min(std::max(iterations / 100, 20UL), 1000UL);
+    printf("reconnect storm, broker down %lu s, then accepts %lu CONNECT/s\n", kOutageMs / 1000,
+           kBrokerAcceptsPerSecond);
+    reconnectStorm("  backoff 5 s, no growth", devices, 5000, 5000);
+    reconnectStorm("  backoff 5..120 s", devices, 5000, 120000);
+    runUntilConnected(); // the storm's broker restart dropped this client too
+
+    printf("published %lu, connects %lu\n", broker.publishes, broker.connects);
+    return DecentIoT.connected() ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+static unsigned long hostMillis = 0;
+static bool hostTimeSynced = true;
+
+// 32 bits like on the device, so code that must survive the ~49-day wrap
+// can be tested; unsigned long itself is wider here
+unsigned long millis()
+{
+    return (uint32_t)hostMillis;
+}
+
+unsigned long micros()
+{
+    return (uint32_t)(hostMillis * 1000UL);
+}
+
+void delay(unsigned long ms)
+{
+    hostMillis += ms;
+}
+
+void yield()
+{
+}
+
+long random(long howBig)
+{
+    return howBig > 0 ? rand() % howBig : 0;
+}
+
+long random(long howSmall, long howBig)
+{
+    return howBig > howSmall ? howSmall + rand() % (howBig - howSmall) : howSmall;
+}
+
+void randomSeed(unsigned long seed)
+{
+    srand((unsigned int)seed);
+}
+
+// NTP is modelled by hostSetTimeSynced() alone
+void configTime(long, int, const char *, const char *, const char *)
+{
+}
+
+// Replaces the C library's time() for the whole program
+time_t time(time_t *out) noexcept
+{
+    time_t now;
+    if (hostTimeSynced)
+    {
+        struct timespec wall;
+        clock_gettime(CLOCK_REALTIME, &wall);
+        now = wall.tv_sec;
+    }
+    else
+    {
+        now = (time_t)(hostMillis / 1000);
+    }
+    if (out != nullptr)
+        *out = now;
+    return now;
+}
+
+void hostSetMillis(unsigned long ms)
+{
+    hostMillis = ms;
+}
+
+void hostAdvanceMillis(unsigned long ms)
+{
+    hostMillis += ms;
+}
+
+void hostSetTimeSynced(bool synced)
+{
+    hostTimeSynced = synced;
+}
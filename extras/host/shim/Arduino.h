@@ -0,0 +1,172 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Host build only: the parts of the Arduino core the library uses, with a
+// clock that tests and benchmarks move by hand
+
+#pragma once
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define DEC 10
+#define HEX 16
+
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+
+class String
+{
+public:
+    String() {}
+    String(const char *text) : _text(text != nullptr ? text : "") {}
+    String(const std::string &text) : _text(text) {}
+    String(char c) : _text(1, c) {}
+    String(int value, unsigned char base = DEC) { _number(value, base); }
+    String(unsigned int value, unsigned char base = DEC) { _number(value, base); }
+    String(long value, unsigned char base = DEC) { _number(value, base); }
+    String(unsigned long value, unsigned char base = DEC) { _number(value, base); }
+    String(float value, unsigned char decimals = 2) { _decimal(value, decimals); }
+    String(double value, unsigned char decimals = 2) { _decimal(value, decimals); }
+
+    const char *c_str() const { return _text.c_str(); }
+    unsigned int length() const { return (unsigned int)_text.size(); }
+    bool reserve(unsigned int size)
+    {
+        _text.reserve(size);
+        return true;
+    }
+    char charAt(unsigned int index) const { return index < _text.size() ? _text[index] : '\0'; }
+    char operator[](unsigned int index) const { return charAt(index); }
+
+    String &operator+=(const String &other)
+    {
+        _text += other._text;
+        return *this;
+    }
+    String &operator+=(const char *other)
+    {
+        _text += other;
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        _text += c;
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a._text + b._text); }
+    friend String operator+(const String &a, const char *b) { return String(a._text + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b._text); }
+
+    bool operator==(const String &other) const { return _text == other._text; }
+    bool operator==(const char *other) const { return _text == other; }
+    bool operator!=(const String &other) const { return _text != other._text; }
+    bool operator!=(const char *other) const { return _text != other; }
+    bool operator<(const String &other) const { return _text < other._text; }
+
+    int indexOf(char c) const { return _find(_text.find(c)); }
+    int indexOf(const char *text) const { return _find(_text.find(text)); }
+    int lastIndexOf(char c) const { return _find(_text.rfind(c)); }
+    String substring(unsigned int from, unsigned int to) const { return String(_text.substr(from, to - from)); }
+    bool startsWith(const String &prefix) const { return _text.compare(0, prefix._text.size(), prefix._text) == 0; }
+    long toInt() const { return atol(_text.c_str()); }
+    float toFloat() const { return (float)atof(_text.c_str()); }
+
+private:
+    template <typename T>
+    void _number(T value, unsigned char base)
+    {
+        char buffer[24];
+        if (base == HEX)
+            snprintf(buffer, sizeof(buffer), "%lx", (unsigned long)value);
+        else if (value < 0)
+            snprintf(buffer, sizeof(buffer), "%ld", (long)value);
+        else
+            snprintf(buffer, sizeof(buffer), "%lu", (unsigned long)value);
+        _text = buffer;
+    }
+    void _decimal(double value, unsigned char decimals)
+    {
+        char buffer[48];
+        snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+        _text = buffer;
+    }
+    static int _find(size_t position) { return position == std::string::npos ? -1 : (int)position; }
+
+    std::string _text;
+};
+
+// Discards output unless echo is set, but still checks printf formats
+class HardwareSerial
+{
+public:
+    bool echo = false;
+
+    void begin(unsigned long) {}
+    size_t print(const char *text) { return _write(text); }
+    size_t print(const String &text) { return _write(text.c_str()); }
+    size_t println(const char *text = "") { return _write(text) + _write("\n"); }
+    size_t println(const String &text) { return println(text.c_str()); }
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        _write(buffer);
+        return n > 0 ? (size_t)n : 0;
+    }
+
+private:
+    size_t _write(const char *text)
+    {
+        if (echo)
+            fputs(text, stdout);
+        return strlen(text);
+    }
+};
+extern HardwareSerial Serial;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+void configTime(long gmtOffset, int daylightOffset, const char *server1,
+                const char *server2 = nullptr, const char *server3 = nullptr);
+
+// Host clock: millis() only moves when these (or delay()) are called
+void hostSetMillis(unsigned long ms);
+void hostAdvanceMillis(unsigned long ms);
+// time() gives the host's wall clock while synced (the default) and
+// seconds since boot otherwise, as the ESP cores do until NTP answers
+void hostSetTimeSynced(bool synced);
@@ -0,0 +1,250 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "PubSubClient.h"
+
+HostBroker &HostBroker::instance()
+{
+    static HostBroker broker;
+    return broker;
+}
+
+bool HostBroker::deliver(const char *topic, const char *payload)
+{
+    if (_clients.empty())
+        return false;
+    // Backwards, so a callback that disconnects its own client does not
+    // shift the ones still to come
+    for (size_t i = _clients.size(); i-- > 0;)
+    {
+        if (i < _clients.size())
+            _clients[i]->_deliver(topic, payload);
+    }
+    return true;
+}
+
+void HostBroker::drop()
+{
+    for (PubSubClient *client : _clients)
+    {
+        client->_connected = false;
+        client->_state = MQTT_CONNECTION_LOST;
+    }
+    _clients.clear();
+}
+
+void HostBroker::_remove(PubSubClient *client)
+{
+    for (size_t i = 0; i < _clients.size(); i++)
+    {
+        if (_clients[i] == client)
+        {
+            _clients.erase(_clients.begin() + i);
+            return;
+        }
+    }
+}
+
+void HostBroker::reset()
+{
+    drop();
+    up = true;
+    refuse = MQTT_CONNECTED;
+    failPublish = false;
+    record = true;
+    connectsPerSecond = 0;
+    _windowConnects = 0;
+    published.clear();
+    subscriptions.clear();
+    publishes = 0;
+    connects = 0;
+    disconnects = 0;
+    sockets = 0;
+}
+
+PubSubClient::~PubSubClient()
+{
+    HostBroker::instance()._remove(this);
+}
+
+bool PubSubClient::setBufferSize(uint16_t size)
+{
+    _buffer.resize(size);
+    return true;
+}
+
+bool PubSubClient::connect(const char *id)
+{
+    return connect(id, nullptr, nullptr);
+}
+
+bool PubSubClient::connect(const char *, const char *, const char *)
+{
+    HostBroker &broker = HostBroker::instance();
+    if (!broker.up)
+    {
+        _connected = false;
+        _state = MQTT_CONNECT_UNAVAILABLE;
+        return false;
+    }
+    if (broker.refuse != MQTT_CONNECTED)
+    {
+        _connected = false;
+        _state = broker.refuse;
+        return false;
+    }
+    if (broker.connectsPerSecond != 0)
+    {
+        if (millis() / 1000 != broker._window)
+        {
+            broker._window = millis() / 1000;
+            broker._windowConnects = 0;
+        }
+        if (broker._windowConnects >= broker.connectsPerSecond)
+        {
+            _connected = false;
+            _state = MQTT_CONNECT_UNAVAILABLE;
+            return false;
+        }
+        broker._windowConnects++;
+    }
+    broker._remove(this); // a client reconnecting replaces its own session
+    broker._clients.push_back(this);
+    broker.connects++;
+    _connected = true;
+    _state = MQTT_CONNECTED;
+    return true;
+}
+
+void PubSubClient::disconnect()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.disconnects++;
+    broker._remove(this);
+    _connected = false;
+    _state = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload)
+{
+    return publish(topic, payload, false);
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained)
+{
+    return _send(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload), retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    return _send(topic, payload, length, false);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+    return _send(topic, payload, length, retained);
+}
+
+bool PubSubClient::beginPublish(const char *topic, unsigned int length, bool retained)
+{
+    if (!_connected || HostBroker::instance().failPublish)
+        return false;
+    _stream.topic = topic;
+    _stream.payload.clear();
+    _stream.retained = retained;
+    _streamLeft = length;
+    _streaming = true;
+    return true;
+}
+
+size_t PubSubClient::write(uint8_t byte)
+{
+    return write(&byte, 1);
+}
+
+size_t PubSubClient::write(const uint8_t *data, size_t size)
+{
+    if (!_streaming || size > _streamLeft)
+        return 0;
+    _stream.payload.append(reinterpret_cast<const char *>(data), size);
+    _streamLeft -= size;
+    return size;
+}
+
+int PubSubClient::endPublish()
+{
+    if (!_streaming)
+        return 0;
+    _streaming = false;
+    if (_streamLeft != 0)
+        return 0;
+    return _send(_stream.topic.c_str(), reinterpret_cast<const uint8_t *>(_stream.payload.data()),
+                 _stream.payload.size(), _stream.retained)
+               ? 1
+               : 0;
+}
+
+bool PubSubClient::subscribe(const char *topic)
+{
+    return subscribe(topic, 0);
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t)
+{
+    if (!_connected)
+        return false;
+    HostBroker &broker = HostBroker::instance();
+    if (broker.record)
+        broker.subscriptions.push_back(topic);
+    return true;
+}
+
+bool PubSubClient::unsubscribe(const char *)
+{
+    return _connected;
+}
+
+bool PubSubClient::_send(const char *topic, const uint8_t *payload, size_t length, bool retained)
+{
+    HostBroker &broker = HostBroker::instance();
+    if (!_connected || broker.failPublish)
+        return false;
+    broker.publishes++;
+    if (broker.record)
+    {
+        HostMessage message;
+        message.topic = topic;
+        message.payload.assign(reinterpret_cast<const char *>(payload), length);
+        message.retained = retained;
+        broker.published.push_back(message);
+    }
+    return true;
+}
+
+// Like PubSubClient, the payload handed over lives in the client's buffer
+void PubSubClient::_deliver(const char *topic, const char *payload)
+{
+    if (!_callback)
+        return;
+    size_t length = strlen(payload);
+    if (length > _buffer.size())
+        return; // PubSubClient drops packets over its buffer size
+    memcpy(_buffer.data(), payload, length);
+    char topicCopy[256];
+    snprintf(topicCopy, sizeof(topicCopy), "%s", topic);
+    _callback(topicCopy, _buffer.data(), (unsigned int)length);
+}
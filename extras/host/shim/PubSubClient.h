@@ -0,0 +1,136 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Host build only: a PubSubClient with the same calls, backed by an
+// in-memory broker that tests and benchmarks inspect and drive
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+
+class PubSubClient;
+
+struct HostMessage
+{
+    std::string topic;
+    std::string payload;
+    bool retained;
+};
+
+// The one broker every PubSubClient in the process talks to. It holds a
+// session per connected client.
+class HostBroker
+{
+public:
+    static HostBroker &instance();
+
+    bool up = true;              // false: sockets and connect() fail
+    int refuse = MQTT_CONNECTED; // connect() refused with this state, e.g. MQTT_CONNECT_BAD_CREDENTIALS
+    bool failPublish = false;    // publishes are refused while connected
+    bool record = true;          // false: keep no messages or subscriptions, e.g. in benchmarks
+    unsigned long connectsPerSecond = 0; // 0: no limit; further CONNECTs that second are refused as unavailable
+    std::vector<HostMessage> published;
+    std::vector<std::string> subscriptions;
+    unsigned long publishes = 0;
+    unsigned long connects = 0;
+    unsigned long disconnects = 0; // disconnect() calls, connected or not
+    unsigned long sockets = 0;     // socket opens attempted, up or not
+
+    // Hands a message to every connected client's callback; false if none
+    bool deliver(const char *topic, const char *payload);
+    // Drops every connected client, as a lost socket would
+    void drop();
+    size_t sessions() const { return _clients.size(); }
+    void reset();
+
+private:
+    friend class PubSubClient;
+    void _remove(PubSubClient *client);
+    std::vector<PubSubClient *> _clients;
+    unsigned long _window = 0; // second of millis() that _windowConnects counts
+    unsigned long _windowConnects = 0;
+};
+
+class PubSubClient
+{
+public:
+    PubSubClient() {}
+    explicit PubSubClient(Client &) {}
+    ~PubSubClient();
+
+    PubSubClient &setServer(const char *, uint16_t) { return *this; }
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE)
+    {
+        _callback = callback;
+        return *this;
+    }
+    PubSubClient &setClient(Client &) { return *this; }
+    PubSubClient &setKeepAlive(uint16_t) { return *this; }
+    PubSubClient &setSocketTimeout(uint16_t) { return *this; }
+    bool setBufferSize(uint16_t size);
+    uint16_t getBufferSize() const { return (uint16_t)_buffer.size(); }
+
+    bool connect(const char *id);
+    bool connect(const char *id, const char *user, const char *pass);
+    void disconnect();
+    bool connected() const { return _connected; }
+    int state() const { return _state; }
+    bool loop() { return _connected; }
+
+    bool publish(const char *topic, const char *payload);
+    bool publish(const char *topic, const char *payload, bool retained);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained);
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *data, size_t size);
+    int endPublish();
+
+    bool subscribe(const char *topic);
+    bool subscribe(const char *topic, uint8_t qos);
+    bool unsubscribe(const char *topic);
+
+private:
+    friend class HostBroker;
+    bool _send(const char *topic, const uint8_t *payload, size_t length, bool retained);
+    void _deliver(const char *topic, const char *payload);
+
+    std::function<void(char *, uint8_t *, unsigned int)> _callback;
+    std::vector<uint8_t> _buffer = std::vector<uint8_t>(256);
+    bool _connected = false;
+    int _state = MQTT_DISCONNECTED;
+    HostMessage _stream;
+    size_t _streamLeft = 0;
+    bool _streaming = false;
+};
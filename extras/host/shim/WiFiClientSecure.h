@@ -0,0 +1,50 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <PubSubClient.h>
+
+// Opens only while the in-memory broker is up and carries no bytes: the
+// host PubSubClient or DecentIoTLoopbackTransport does the talking
+class WiFiClientSecure : public Client
+{
+public:
+    void setCACert(const char *) {}
+    void setInsecure() {}
+    void setTimeout(unsigned long) {}
+
+    int connect(const char *, uint16_t) override
+    {
+        HostBroker &broker = HostBroker::instance();
+        broker.sockets++;
+        _open = broker.up;
+        return _open ? 1 : 0;
+    }
+    size_t write(const uint8_t *, size_t) override { return 0; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int read(uint8_t *, size_t) override { return 0; }
+    void flush() override {}
+    void stop() override { _open = false; }
+    uint8_t connected() override { return _open ? 1 : 0; }
+
+private:
+    bool _open = false;
+};
@@ -0,0 +1,51 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Minimal checks for the host tests: each failure is printed, and main()
+// returns HOST_TEST_RESULT() so ctest sees a non-zero exit
+
+#pragma once
+
+#include <stdio.h>
+#include <string.h>
+
+static int hostTestFailures = 0;
+
+#define CHECK(condition)                                                          \
+    do                                                                            \
+    {                                                                             \
+        if (!(condition))                                                         \
+        {                                                                         \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            hostTestFailures++;                                                   \
+        }                                                                         \
+    } while (0)
+
+#define CHECK_STR(actual, expected)                                                       \
+    do                                                                                    \
+    {                                                                                     \
+        const char *hostActual = (actual);                                                \
+        const char *hostExpected = (expected);                                            \
+        if (strcmp(hostActual, hostExpected) != 0)                                        \
+        {                                                                                 \
+            printf("%s:%d: got \"%s\", expected \"%s\"\n", __FILE__, __LINE__, hostActual, \
+                   hostExpected);                                                         \
+            hostTestFailures++;                                                           \
+        }                                                                                 \
+    } while (0)
+
+#define HOST_TEST_RESULT() (hostTestFailures == 0 ? (printf("ok\n"), 0) : 1)
@@ -0,0 +1,232 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <string>
+
+static const char *kPrefix = "project/users/uid/datastreams/device/";
+
+static std::string topic(const char *suffix)
+{
+    return std::string(kPrefix) + suffix;
+}
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+// connected() turns true with the socket; subscribing and the status
+// publish take one more run()
+static bool runUntilConnected()
+{
+    for (int i = 0; i < 2000 && !DecentIoT.connected(); i++)
+    {
+        hostAdvanceMillis(10);
+        DecentIoT.run();
+    }
+    runFor(10);
+    return DecentIoT.connected();
+}
+
+// Last message published on topic, nullptr if none
+static const HostMessage *lastOn(const std::string &name)
+{
+    const std::vector<HostMessage> &published = HostBroker::instance().published;
+    for (size_t i = published.size(); i-- > 0;)
+    {
+        if (published[i].topic == name)
+            return &published[i];
+    }
+    return nullptr;
+}
+
+static size_t countOn(const std::string &name)
+{
+    size_t count = 0;
+    for (const HostMessage &message : HostBroker::instance().published)
+        count += message.topic == name;
+    return count;
+}
+
+// Pins convert to their names; DECENTIOT_PIN_NAME() keeps literal pasting
+static void testPinNames()
+{
+    CHECK_STR(P7, "P7");
+    CHECK(P7.id == 7);
+    CHECK_STR("prefix/" DECENTIOT_PIN_NAME(7), "prefix/P7");
+}
+
+static void testWrite()
+{
+    HostBroker::instance().published.clear();
+    DecentIoT.write(P1, 23.5f);
+    DecentIoT.write(P2, 7);
+    DecentIoT.write(P3, "on");
+    const HostMessage *message = lastOn(topic("P1/value"));
+    CHECK(message != nullptr && message->payload == "23.5" && message->retained);
+    message = lastOn(topic("P2/value"));
+    CHECK(message != nullptr && message->payload == "7");
+    message = lastOn(topic("P3/value"));
+    CHECK(message != nullptr && message->payload == "on");
+
+    DecentIoT.setPrecision(P1, 2);
+    DecentIoT.write(P1, 0.1f);
+    message = lastOn(topic("P1/value"));
+    CHECK(message != nullptr && message->payload == "0.10");
+    DecentIoT.setPrecision(P1, 0);
+    DecentIoT.write(P1, 23.4f);
+    message = lastOn(topic("P1/value"));
+    CHECK(message != nullptr && message->payload == "23.0");
+    DecentIoT.setPrecision(P1, -1);
+}
+
+static void testReceive()
+{
+    HostBroker &broker = HostBroker::instance();
+    bool subscribed = false;
+    for (const std::string &name : broker.subscriptions)
+        subscribed |= name == topic("P4/value");
+    CHECK(subscribed);
+
+    CHECK(broker.deliver(topic("P4/value").c_str(), "42"));
+    CHECK(broker.deliver(topic("P5/value").c_str(), "hello"));
+    CHECK(broker.deliver(topic("batch/set").c_str(), "{\"P4\":7}"));
+    runFor(20);
+}
+
+static void testBatch()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.published.clear();
+    DecentIoT.beginBatch();
+    DecentIoT.add(P6, 1);
+    DecentIoT.add(P7, "a\"b");
+    CHECK(DecentIoT.commitBatch());
+    const HostMessage *message = lastOn(topic("batch"));
+    CHECK(message != nullptr && message->payload == "{\"P6\":1,\"P7\":\"a\\\"b\"}");
+
+    // Our own batch topic is not subscribed, so it is never echoed back
+    for (const std::string &name : broker.subscriptions)
+        CHECK(name != topic("batch") && name != topic("#"));
+
+    // A refused batch goes back through the queue value by value
+    broker.published.clear();
+    broker.failPublish = true;
+    DecentIoT.beginBatch();
+    DecentIoT.add(P6, 2);
+    DecentIoT.add(P7, "c\"d");
+    CHECK(!DecentIoT.commitBatch());
+    CHECK(DecentIoT.getQueueDepth() == 2);
+    broker.failPublish = false;
+    runFor(100);
+    CHECK(DecentIoT.getQueueDepth() == 0);
+    message = lastOn(topic("P6/value"));
+    CHECK(message != nullptr && message->payload == "2");
+    message = lastOn(topic("P7/value"));
+    CHECK(message != nullptr && message->payload == "c\"d");
+}
+
+// Values written while the broker is gone are published once it is back
+static void testOfflineQueue()
+{
+    HostBroker &broker = HostBroker::instance();
+    unsigned long connects = broker.connects;
+    broker.up = false;
+    broker.drop();
+    runFor(20);
+    CHECK(!DecentIoT.connected());
+
+    for (int i = 0; i < 5; i++)
+        DecentIoT.write(P8, i);
+    CHECK(DecentIoT.getQueueDepth() == 5);
+
+    broker.published.clear();
+    broker.up = true;
+    CHECK(runUntilConnected());
+    runFor(100);
+    CHECK(broker.connects == connects + 1);
+    CHECK(DecentIoT.getQueueDepth() == 0);
+    CHECK(countOn(topic("P8/value")) == 5);
+    const HostMessage *message = lastOn(topic("P8/value"));
+    CHECK(message != nullptr && message->payload == "4");
+}
+
+// One "+/value" subscription instead of one per pin; pins without a
+// handler are dropped, including echoes of our own writes
+static void testWildcard(int &received)
+{
+    HostBroker &broker = HostBroker::instance();
+    DecentIoT.setSubscribeMode(DECENTIOT_SUBSCRIBE_WILDCARD);
+    broker.drop();
+    broker.subscriptions.clear();
+    CHECK(runUntilConnected());
+    CHECK(broker.subscriptions.size() == 2 && broker.subscriptions[0] == topic("+/value") &&
+          broker.subscriptions[1] == topic("batch/set"));
+
+    int before = received;
+    CHECK(broker.deliver(topic("P4/value").c_str(), "42"));
+    CHECK(broker.deliver(topic("P9/value").c_str(), "42"));
+    CHECK(broker.deliver(topic("P4/other").c_str(), "42"));
+    CHECK(received == before + 1);
+
+    // Back to one subscription per receive pin
+    DecentIoT.setSubscribeMode(DECENTIOT_SUBSCRIBE_PER_PIN);
+    broker.drop();
+    broker.subscriptions.clear();
+    CHECK(runUntilConnected());
+    CHECK(broker.subscriptions.size() == 3);
+}
+
+int main()
+{
+    int received = 0;
+    int batchReceived = 0;
+    std::string text;
+
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setQueueMode(DECENTIOT_QUEUE_FIFO);
+    DecentIoT.setQueueDrainRate(0);
+    DecentIoT.onReceive(P4, [&](const DecentIoTValue &value) {
+        if ((int)value == 42)
+            received++;
+        else if ((int)value == 7)
+            batchReceived++;
+    });
+    DecentIoT.onReceive(P5, [&](const DecentIoTValue &value) { text = value.toString().c_str(); });
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    CHECK(runUntilConnected());
+
+    testPinNames();
+    testWrite();
+    testReceive();
+    CHECK(received == 1);
+    CHECK(batchReceived == 1);
+    CHECK_STR(text.c_str(), "hello");
+    testBatch();
+    testOfflineQueue();
+    testWildcard(received);
+    return HOST_TEST_RESULT();
+}
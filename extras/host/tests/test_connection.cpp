@@ -0,0 +1,220 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The connection states are private; this test walks through them
+#define private public
+#include "DecentIoT.h"
+#undef private
+#include "HostTest.h"
+
+typedef DecentIoTClass::ConnectionState State;
+
+static std::vector<State> visited;
+static unsigned long blockingRuns = 0;
+static double slowestRunMs = 0;
+
+static void visit(State state)
+{
+    if (visited.empty() || visited.back() != state)
+        visited.push_back(state);
+}
+
+// One run() every step ms. run() must never wait: the fake clock only moves
+// here, so a delay() inside it would show up as time passing
+static void step(unsigned long ms = 10)
+{
+    hostAdvanceMillis(ms);
+    unsigned long before = millis();
+    unsigned long disconnects = HostBroker::instance().disconnects;
+    auto start = std::chrono::steady_clock::now();
+    DecentIoT.run();
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (millis() != before)
+        blockingRuns++;
+    if (elapsed > slowestRunMs)
+        slowestRunMs = elapsed;
+    // DISCONNECTING is left within the run() that enters it; it shows as
+    // the disconnect() it makes on the way to TIME_SYNC
+    if (HostBroker::instance().disconnects != disconnects &&
+        DecentIoT._connState == DecentIoTClass::CONN_TIME_SYNC)
+        visit(DecentIoTClass::CONN_DISCONNECTING);
+    visit(DecentIoT._connState);
+}
+
+// Steps until the state is reached; the fake ms it took, or -1
+static long stepUntil(State state, unsigned long limit = 60000)
+{
+    for (unsigned long elapsed = 0; elapsed <= limit; elapsed += 10)
+    {
+        if (DecentIoT._connState == state)
+            return (long)elapsed;
+        step();
+    }
+    return -1;
+}
+
+static bool visitedInOrder(const std::vector<State> &expected)
+{
+    return visited == expected;
+}
+
+// WiFi down: nothing is attempted. It stays down for longer than the time
+// sync timeout, like a cold boot with a slow access point.
+static void testIdleWithoutWiFi()
+{
+    visited.clear();
+    for (int i = 0; i < 1000; i++)
+        step();
+    CHECK(DecentIoT._connState == DecentIoTClass::CONN_IDLE);
+    CHECK(HostBroker::instance().sockets == 0);
+    CHECK_STR(DecentIoT.getStatus(), "disconnected");
+}
+
+// No NTP answer: TIME_SYNC holds for the full timeout from when WiFi came
+// up, then gives up and tries TLS anyway
+static void testTimeSyncTimeout()
+{
+    HostBroker::instance().up = false;
+    visited.clear();
+    WiFi.setStatus(WL_CONNECTED);
+    step();
+    CHECK(DecentIoT._connState == DecentIoTClass::CONN_TIME_SYNC);
+    CHECK_STR(DecentIoT.getStatus(), "connecting");
+    CHECK(stepUntil(DecentIoTClass::CONN_TLS_HANDSHAKE) >= (long)DecentIoT._timeSyncTimeout - 10);
+    CHECK_STR(DecentIoT.getLastError(), "time sync failed");
+    CHECK(stepUntil(DecentIoTClass::CONN_IDLE) >= 0);
+    CHECK_STR(DecentIoT.getLastError(), "TLS connection failed");
+    CHECK(visitedInOrder({DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_IDLE}));
+    hostSetTimeSynced(true);
+}
+
+// Socket refused: back to IDLE, and the retry waits out the backoff
+static void testSocketFailure()
+{
+    HostBroker &broker = HostBroker::instance();
+    unsigned long sockets = broker.sockets;
+    visited.clear();
+    CHECK(stepUntil(DecentIoTClass::CONN_TLS_HANDSHAKE) >= 0);
+    CHECK(stepUntil(DecentIoTClass::CONN_IDLE) >= 0);
+    CHECK(broker.sockets == sockets + 1);
+    CHECK_STR(DecentIoT.getLastError(), "TLS connection failed");
+    CHECK(visitedInOrder({DecentIoTClass::CONN_IDLE, DecentIoTClass::CONN_DISCONNECTING,
+                          DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_IDLE}));
+    CHECK(DecentIoT._reconnectDelay >= 1 && DecentIoT._reconnectDelay <= 1000);
+}
+
+// CONNACK refusal: the socket opens, CONNECT fails, the socket is closed
+static void testConnectRefused()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.up = true;
+    broker.refuse = MQTT_CONNECT_BAD_CREDENTIALS;
+    visited.clear();
+    CHECK(stepUntil(DecentIoTClass::CONN_MQTT_CONNECT) >= 0);
+    CHECK(stepUntil(DecentIoTClass::CONN_IDLE) >= 0);
+    CHECK_STR(DecentIoT.getLastError(), "MQTT connect failed");
+    CHECK(visitedInOrder({DecentIoTClass::CONN_IDLE, DecentIoTClass::CONN_DISCONNECTING,
+                          DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_MQTT_CONNECT, DecentIoTClass::CONN_IDLE}));
+    CHECK(!DecentIoT._client.connected());
+    broker.refuse = MQTT_CONNECTED;
+}
+
+static void testConnect()
+{
+    HostBroker &broker = HostBroker::instance();
+    visited.clear();
+    CHECK(stepUntil(DecentIoTClass::CONN_CONNECTED) >= 0);
+    CHECK(visitedInOrder({DecentIoTClass::CONN_IDLE, DecentIoTClass::CONN_DISCONNECTING,
+                          DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_MQTT_CONNECT, DecentIoTClass::CONN_RESUBSCRIBE,
+                          DecentIoTClass::CONN_CONNECTED}));
+    CHECK(broker.connects == 1);
+    CHECK(!broker.subscriptions.empty());
+    CHECK(DecentIoT._reconnectAttempts == 0);
+    CHECK_STR(DecentIoT.getStatus(), "connected");
+}
+
+// Session dropped by the broker: IDLE, backoff, full sequence again
+static void testSessionLost()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.drop();
+    visited.clear();
+    step();
+    CHECK(DecentIoT._connState == DecentIoTClass::CONN_IDLE);
+    CHECK(stepUntil(DecentIoTClass::CONN_CONNECTED) >= 0);
+    CHECK(visitedInOrder({DecentIoTClass::CONN_IDLE, DecentIoTClass::CONN_DISCONNECTING,
+                          DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_MQTT_CONNECT, DecentIoTClass::CONN_RESUBSCRIBE,
+                          DecentIoTClass::CONN_CONNECTED}));
+    CHECK(broker.connects == 2);
+}
+
+// WiFi lost: IDLE at once; WiFi back: connect without a backoff wait
+static void testWiFiLost()
+{
+    WiFi.setStatus(WL_DISCONNECTED);
+    visited.clear();
+    step();
+    CHECK(DecentIoT._connState == DecentIoTClass::CONN_IDLE);
+    CHECK(!DecentIoT._pubsub.connected());
+    step(60000);
+
+    WiFi.setStatus(WL_CONNECTED);
+    visited.clear();
+    step();
+    CHECK(DecentIoT._connState == DecentIoTClass::CONN_TIME_SYNC);
+    long took = stepUntil(DecentIoTClass::CONN_CONNECTED);
+    CHECK(took >= 0 && took < 100);
+    CHECK(visitedInOrder({DecentIoTClass::CONN_TIME_SYNC, DecentIoTClass::CONN_TLS_HANDSHAKE,
+                          DecentIoTClass::CONN_MQTT_CONNECT, DecentIoTClass::CONN_RESUBSCRIBE,
+                          DecentIoTClass::CONN_CONNECTED}));
+}
+
+int main()
+{
+    hostSetTimeSynced(false); // NTP has not answered yet
+    WiFi.setStatus(WL_DISCONNECTED);
+    DecentIoT.setReconnectBackoff(100, 1000);
+    DecentIoT.onReceive(P1, [](const DecentIoTValue &) {});
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+
+    testIdleWithoutWiFi();
+    testTimeSyncTimeout();
+    testSocketFailure();
+    testConnectRefused();
+    testConnect();
+    testSessionLost();
+    testWiFiLost();
+
+    CHECK(blockingRuns == 0);
+    CHECK(slowestRunMs < 50);
+    return HOST_TEST_RESULT();
+}
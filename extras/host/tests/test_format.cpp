@@ -0,0 +1,127 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <random>
+
+static const char *formatFloat(float value, int8_t decimals)
+{
+    static char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatFloat(value, decimals, buffer, sizeof(buffer));
+    return buffer;
+}
+
+static DecentIoTValue parse(const char *text)
+{
+    return DecentIoTValue::fromPayload(reinterpret_cast<const uint8_t *>(text), strlen(text));
+}
+
+static void testInts()
+{
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatInt(0, buffer, sizeof(buffer));
+    CHECK_STR(buffer, "0");
+    DecentIoTFormat::formatInt(-2147483647 - 1, buffer, sizeof(buffer));
+    CHECK_STR(buffer, "-2147483648");
+    DecentIoTFormat::formatUint(4000000000U, buffer, sizeof(buffer));
+    CHECK_STR(buffer, "4000000000");
+
+    // Too small a buffer gives an empty string, never a truncated number
+    char small[4];
+    CHECK(DecentIoTFormat::formatInt(12345, small, sizeof(small)) == 0);
+    CHECK_STR(small, "");
+}
+
+static void testShortestFloats()
+{
+    CHECK_STR(formatFloat(0.0f, -1), "0.0");
+    CHECK_STR(formatFloat(-0.0f, -1), "-0.0");
+    CHECK_STR(formatFloat(0.1f, -1), "0.1");
+    CHECK_STR(formatFloat(23.5f, -1), "23.5");
+    CHECK_STR(formatFloat(100.0f, -1), "100.0");
+    CHECK_STR(formatFloat(1.0f / 3, -1), "0.33333334");
+    CHECK_STR(formatFloat(123456789.0f, -1), "123456790.0");
+    CHECK_STR(formatFloat(1e9f, -1), "1e9");
+    CHECK_STR(formatFloat(-2.5e-7f, -1), "-2.5e-7");
+    CHECK_STR(formatFloat(3.4028235e38f, -1), "3.4028235e38");
+    CHECK_STR(formatFloat(1.4e-45f, -1), "1e-45");
+    CHECK_STR(formatFloat(NAN, -1), "nan");
+    CHECK_STR(formatFloat(-INFINITY, -1), "-inf");
+}
+
+static void testFixedFloats()
+{
+    CHECK_STR(formatFloat(23.456f, 2), "23.46");
+    CHECK_STR(formatFloat(23.456f, 1), "23.5");
+    CHECK_STR(formatFloat(-23.456f, 3), "-23.456");
+    // Precision 0 keeps ".0" so the receiver still sees a FLOAT
+    CHECK_STR(formatFloat(23.456f, 0), "23.0");
+    CHECK(parse(formatFloat(23.456f, 0)).type == DecentIoTValue::FLOAT);
+}
+
+// Every finite float comes back bit-exact, as a FLOAT
+static void testRoundTrip()
+{
+    std::mt19937 random(12345);
+    int failures = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        uint32_t bits = random();
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        if (!isfinite(value))
+            continue;
+        DecentIoTValue parsed = parse(formatFloat(value, -1));
+        if (parsed.type != DecentIoTValue::FLOAT || parsed.floatValue != value)
+        {
+            if (failures++ < 5)
+                printf("round trip failed for %.9g: %s\n", value, formatFloat(value, -1));
+        }
+    }
+    CHECK(failures == 0);
+}
+
+static void testParser()
+{
+    DecentIoTValue v = parse("true");
+    CHECK(v.type == DecentIoTValue::BOOL && v.boolValue);
+    v = parse("-42");
+    CHECK(v.type == DecentIoTValue::INT && v.intValue == -42);
+    v = parse("4294967296");
+    CHECK(v.type == DecentIoTValue::FLOAT);
+    v = parse("1.5e3");
+    CHECK(v.type == DecentIoTValue::FLOAT && v.floatValue == 1500.0f);
+    v = parse("0e999");
+    CHECK(v.type == DecentIoTValue::FLOAT && v.floatValue == 0.0f);
+    v = parse("1e-999");
+    CHECK(v.type == DecentIoTValue::FLOAT && v.floatValue == 0.0f);
+    v = parse("1.5abc");
+    CHECK(v.type == DecentIoTValue::STRING);
+    CHECK_STR(v.toString().c_str(), "1.5abc");
+}
+
+int main()
+{
+    testInts();
+    testShortestFloats();
+    testFixedFloats();
+    testRoundTrip();
+    testParser();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,171 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <algorithm>
+#include <string>
+
+static const std::string kPrefix = "project/users/uid/datastreams/";
+
+static DecentIoTDevice meter1("meter-01");
+static DecentIoTDevice meter2("meter-02");
+static DecentIoTDevice stray("meter-99"); // never added
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+static bool subscribed(const std::string &topic)
+{
+    const std::vector<std::string> &topics = HostBroker::instance().subscriptions;
+    return std::find(topics.begin(), topics.end(), topic) != topics.end();
+}
+
+static size_t countPublished(const std::string &topic)
+{
+    size_t count = 0;
+    for (const HostMessage &message : HostBroker::instance().published)
+        count += message.topic == topic;
+    return count;
+}
+
+static const HostMessage *lastPublished(const std::string &topic)
+{
+    const HostMessage *found = nullptr;
+    for (const HostMessage &message : HostBroker::instance().published)
+    {
+        if (message.topic == topic)
+            found = &message;
+    }
+    return found;
+}
+
+// Only pins with handlers, and only on devices that were added
+static void testSubscriptions()
+{
+    CHECK(subscribed(kPrefix + "device/P1/value"));
+    CHECK(subscribed(kPrefix + "meter-01/P2/value"));
+    CHECK(subscribed(kPrefix + "meter-02/P2/value"));
+    CHECK(subscribed(kPrefix + "meter-02/P3/value"));
+    CHECK(!subscribed(kPrefix + "meter-01/P3/value"));
+    CHECK(!subscribed(kPrefix + "meter-99/P2/value"));
+    CHECK(subscribed(kPrefix + "device/batch/set"));
+    CHECK(HostBroker::instance().subscriptions.size() == 5);
+}
+
+// Inbound messages reach the handler of the device named in the topic
+static void testDispatch(std::string &log)
+{
+    HostBroker &broker = HostBroker::instance();
+    log.clear();
+    broker.deliver((kPrefix + "meter-02/P2/value").c_str(), "7");
+    broker.deliver((kPrefix + "meter-01/P2/value").c_str(), "5");
+    broker.deliver((kPrefix + "meter-02/P3/value").c_str(), "on");
+    broker.deliver((kPrefix + "device/P1/value").c_str(), "1");
+    broker.deliver((kPrefix + "meter-99/P2/value").c_str(), "9"); // unknown device
+    broker.deliver((kPrefix + "meter-01/P3/value").c_str(), "9"); // no handler
+    runFor(20);
+    CHECK_STR(log.c_str(), "m2.P2=7 m1.P2=5 m2.P3=on gw.P1=1 ");
+}
+
+static void testWrites()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.published.clear();
+    meter1.write(P5, 230);
+    meter2.write(P5, 1.5f);
+    meter2.write(P6, "ok");
+    DecentIoT.write(P5, 1);
+    stray.write(P5, 9); // not added: dropped
+    runFor(20);
+    const HostMessage *m1 = lastPublished(kPrefix + "meter-01/P5/value");
+    const HostMessage *m2 = lastPublished(kPrefix + "meter-02/P5/value");
+    const HostMessage *text = lastPublished(kPrefix + "meter-02/P6/value");
+    const HostMessage *own = lastPublished(kPrefix + "device/P5/value");
+    CHECK(m1 != nullptr && m1->payload == "230" && m1->retained);
+    CHECK(m2 != nullptr && m2->payload == "1.5");
+    CHECK(text != nullptr && text->payload == "ok");
+    CHECK(own != nullptr && own->payload == "1");
+    CHECK(countPublished(kPrefix + "meter-99/P5/value") == 0);
+
+    meter1.publishStatus("maintenance");
+    const HostMessage *status = lastPublished(kPrefix + "meter-01/status");
+    CHECK(status != nullptr && status->payload == "maintenance" && status->retained);
+}
+
+// Each device sends its own heartbeat, and an offline one goes quiet
+static void testHeartbeats()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.published.clear();
+    meter2.setOnline(false);
+    runFor(3000);
+    CHECK(countPublished(kPrefix + "meter-01/status") == 3);
+    CHECK(countPublished(kPrefix + "meter-02/status") == 0);
+
+    meter2.setOnline(true); // announces itself on the next run()
+    runFor(10);
+    CHECK(countPublished(kPrefix + "meter-02/status") == 1);
+}
+
+// After a reconnect the devices are subscribed again
+static void testResubscribe()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.drop();
+    broker.subscriptions.clear();
+    runFor(10000);
+    CHECK(DecentIoT.connected());
+    testSubscriptions();
+}
+
+int main()
+{
+    std::string log;
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setReconnectBackoff(100, 100);
+    DecentIoT.onReceive(P1, [&](const DecentIoTValue &v) { log += "gw.P1=" + std::string(v.toString().c_str()) + " "; });
+    meter1.onReceive(P2, [&](const DecentIoTValue &v) { log += "m1.P2=" + std::string(v.toString().c_str()) + " "; });
+    meter2.onReceive(P2, [&](const DecentIoTValue &v) { log += "m2.P2=" + std::string(v.toString().c_str()) + " "; });
+    meter2.onReceive(P3, [&](const DecentIoTValue &v) { log += "m2.P3=" + std::string(v.toString().c_str()) + " "; });
+    stray.onReceive(P2, [&](const DecentIoTValue &v) { log += "stray "; (void)v; });
+    CHECK(DecentIoT.addDevice(meter1));
+    CHECK(DecentIoT.addDevice(meter2));
+    CHECK(!DecentIoT.addDevice(meter1)); // already added
+
+    meter1.setHeartbeatInterval(1000);
+    meter2.setHeartbeatInterval(1000);
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runFor(100);
+    CHECK(DecentIoT.connected());
+
+    testSubscriptions();
+    testDispatch(log);
+    testWrites();
+    testHeartbeats();
+    testResubscribe();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,140 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <string>
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+static void testHistogram()
+{
+    DecentIoTHistogram histogram;
+    CHECK(histogram.percentile(50) == 0 && histogram.mean() == 0);
+    const uint32_t values[] = {0, 1, 2, 3, 5, 6, 7, 100, 1000, 70000};
+    for (uint32_t value : values)
+        histogram.record(value);
+    CHECK(histogram.count == 10);
+    CHECK(histogram.max == 70000);
+    CHECK(histogram.mean() == 7112);
+    CHECK(histogram.buckets[0] == 1);  // 0
+    CHECK(histogram.buckets[1] == 1);  // 1
+    CHECK(histogram.buckets[2] == 2);  // 2..3
+    CHECK(histogram.buckets[3] == 3);  // 4..7
+    CHECK(histogram.buckets[7] == 1);  // 64..127
+    CHECK(histogram.percentile(50) == 7);
+    CHECK(histogram.percentile(80) == 127);
+    CHECK(histogram.percentile(100) == 70000); // capped at the maximum
+
+    DecentIoTHistogram huge;
+    huge.record(UINT32_MAX);
+    CHECK(huge.buckets[DECENTIOT_HISTOGRAM_BUCKETS - 1] == 1);
+}
+
+static void testCounters()
+{
+    HostBroker &broker = HostBroker::instance();
+    DecentIoT.resetStats();
+    DecentIoT.write(P1, 12);
+    DecentIoT.write(P1, 345);
+    DecentIoT.beginBatch();
+    DecentIoT.add(P2, 1);
+    DecentIoT.commitBatch();
+    broker.deliver("project/users/uid/datastreams/device/P3/value", "hello");
+    runFor(50);
+
+    const DecentIoTStats &stats = DecentIoT.getStats();
+    CHECK(stats.pins[1].publishes == 2);
+    CHECK(stats.pins[1].bytesSent == 5);
+    CHECK(stats.batches == 1);
+    CHECK(stats.batchBytes == strlen("{\"P2\":1}"));
+    CHECK(stats.pins[3].received == 1);
+    CHECK(stats.pins[3].bytesReceived == 5);
+    CHECK(stats.runTime.count == 5);
+
+    // Offline: the queue holds DECENTIOT_QUEUE_SIZE values, the rest are dropped
+    broker.up = false;
+    broker.drop();
+    runFor(20);
+    DecentIoT.setQueueMode(P4, DECENTIOT_QUEUE_FIFO);
+    for (int i = 0; i < DECENTIOT_QUEUE_SIZE + 3; i++)
+        DecentIoT.write(P4, i);
+    CHECK(stats.pins[4].drops == 3);
+
+    // Reconnect time runs from losing the session to being connected again
+    runFor(1000);
+    broker.up = true;
+    runFor(2000);
+    CHECK(DecentIoT.connected());
+    CHECK(stats.reconnects == 1);
+    CHECK(stats.reconnectTime.count == 1 && stats.reconnectTime.max >= 1000);
+    CHECK(stats.tlsHandshake.count >= 1);
+}
+
+static void testMetricsTopic()
+{
+    HostBroker &broker = HostBroker::instance();
+    const std::string topic = "project/users/uid/datastreams/device/metrics";
+    broker.published.clear();
+    DecentIoT.setMetricsInterval(1000);
+    runFor(990);
+    size_t before = 0;
+    for (const HostMessage &message : broker.published)
+        before += message.topic == topic;
+    CHECK(before == 0);
+    runFor(20);
+    const HostMessage *metrics = nullptr;
+    for (const HostMessage &message : broker.published)
+    {
+        if (message.topic == topic)
+            metrics = &message;
+    }
+    CHECK(metrics != nullptr && !metrics->retained);
+    CHECK(metrics != nullptr && metrics->payload.compare(0, 7, "{\"pub\":") == 0);
+    CHECK(metrics != nullptr && metrics->payload.find("\"reconnects\":1") != std::string::npos);
+    CHECK(metrics != nullptr && metrics->payload.back() == '}');
+
+    DecentIoT.setMetricsInterval(0);
+    DecentIoT.resetStats();
+    CHECK(DecentIoT.getStats().reconnects == 0);
+    CHECK(DecentIoT.getStats().pins[1].publishes == 0);
+}
+
+int main()
+{
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setReconnectBackoff(100, 100);
+    DecentIoT.onReceive(P3, [](const DecentIoTValue &) {});
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runFor(100);
+    CHECK(DecentIoT.connected());
+
+    testHistogram();
+    testCounters();
+    testMetricsTopic();
+    return HOST_TEST_RESULT();
+}
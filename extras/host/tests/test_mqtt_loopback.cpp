@@ -0,0 +1,230 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTMqtt.h"
+#include "DecentIoTTransport.h"
+#include "HostTest.h"
+
+#include <WiFiClientSecure.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+static WiFiClientSecure unusedSocket;
+
+static bool sentStartsWith(const DecentIoTLoopbackTransport &link, const std::vector<uint8_t> &expected)
+{
+    const std::vector<uint8_t> &sent = link.sent();
+    return sent.size() >= expected.size() && std::equal(expected.begin(), expected.end(), sent.begin());
+}
+
+static void testConnectV5()
+{
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker", 1883);
+    const uint8_t connack[] = {0x20, 3, 0, 0, 0};
+    link.inject(connack, sizeof(connack));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.connected());
+    CHECK(mqtt.protocolVersion() == 5);
+    // CONNECT, "MQTT" level 5, clean session, keep-alive, no properties, id "dev"
+    CHECK(sentStartsWith(link, {0x10, 16, 0, 4, 'M', 'Q', 'T', 'T', 5, 0x02}));
+    CHECK(link.sent().size() == 18);
+
+    // QoS 0 publish: topic, empty property list, payload
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", "hi", false));
+    CHECK(sentStartsWith(link, {0x30, 8, 0, 3, 'a', '/', 'b', 0, 'h', 'i'}));
+
+    // Partial writes still produce the whole packet
+    link.clearSent();
+    link.setChunkLimit(3);
+    CHECK(mqtt.publish("a/b", "hi", true));
+    CHECK(sentStartsWith(link, {0x31, 8, 0, 3, 'a', '/', 'b', 0, 'h', 'i'}));
+    link.setChunkLimit(0);
+}
+
+static void testInboundAndQos1()
+{
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker", 1883);
+    mqtt.setProtocolVersion(4);
+    std::string received;
+    mqtt.setCallback([&](char *topic, uint8_t *payload, unsigned int length) {
+        received = std::string(topic) + "=" + std::string(reinterpret_cast<char *>(payload), length);
+    });
+    const uint8_t connack[] = {0x20, 2, 0, 0};
+    link.inject(connack, sizeof(connack));
+    CHECK(mqtt.connect("dev", "user", "pass"));
+    CHECK(mqtt.protocolVersion() == 4);
+
+    link.clearSent();
+    CHECK(mqtt.subscribe("x/+"));
+    CHECK(sentStartsWith(link, {0x82, 8, 0, 1, 0, 3, 'x', '/', '+', 0}));
+
+    // Inbound QoS 0 publish, split over several reads
+    link.setChunkLimit(2);
+    const uint8_t publish[] = {0x30, 9, 0, 3, 'x', '/', '1', '4', '2', '.', '5'};
+    link.inject(publish, sizeof(publish));
+    for (int i = 0; i < 10 && received.empty(); i++)
+        mqtt.loop();
+    link.setChunkLimit(0);
+    CHECK_STR(received.c_str(), "x/1=42.5");
+
+    // QoS 1 stays in flight until its PUBACK
+    link.clearSent();
+    const uint8_t value[] = {'1'};
+    CHECK(mqtt.publish("t", value, sizeof(value), false, 1));
+    CHECK(mqtt.inflight() == 1);
+    const std::vector<uint8_t> &sent = link.sent();
+    CHECK(sent.size() == 8 && sent[0] == 0x32);
+    uint8_t puback[] = {0x40, 2, sent[5], sent[6]};
+    link.inject(puback, sizeof(puback));
+    mqtt.loop();
+    CHECK(mqtt.inflight() == 0);
+
+    // Too large for the in-flight slot: refused rather than allocated
+    std::vector<uint8_t> big(DECENTIOT_MQTT_INFLIGHT_PACKET, 'x');
+    CHECK(!mqtt.publish("t", big.data(), big.size(), false, 1));
+    CHECK(mqtt.publish("t", big.data(), big.size(), false, 0));
+}
+
+// The first publish under an alias carries topic and alias, later ones an
+// empty topic and the alias alone
+static void testTopicAliases()
+{
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker", 1883);
+    // CONNACK with Topic Alias Maximum 10
+    const uint8_t connack[] = {0x20, 6, 0, 0, 3, 0x22, 0, 10};
+    link.inject(connack, sizeof(connack));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.topicAliasMax() == 10);
+
+    const uint8_t value[] = {'4', '2'};
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", value, sizeof(value), true, 0, 1));
+    CHECK(link.sent() == std::vector<uint8_t>({0x31, 11, 0, 3, 'a', '/', 'b', 3, 0x23, 0, 1, '4', '2'}));
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", value, sizeof(value), true, 0, 1));
+    CHECK(link.sent() == std::vector<uint8_t>({0x31, 8, 0, 0, 3, 0x23, 0, 1, '4', '2'}));
+
+    // Past the broker's maximum: no alias at all
+    link.clearSent();
+    CHECK(mqtt.publish("a/c", value, sizeof(value), true, 0, 11));
+    CHECK(link.sent() == std::vector<uint8_t>({0x31, 8, 0, 3, 'a', '/', 'c', 0, '4', '2'}));
+
+    // A new connection knows no aliases: the topic goes out again
+    mqtt.disconnect();
+    link.inject(connack, sizeof(connack));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", value, sizeof(value), true, 0, 1));
+    CHECK(link.sent() == std::vector<uint8_t>({0x31, 11, 0, 3, 'a', '/', 'b', 3, 0x23, 0, 1, '4', '2'}));
+}
+
+// An unacknowledged QoS 1 publish is resent with its full topic, and with
+// its alias only if the new connection allows that alias
+static void testResendAfterAliasChange()
+{
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker", 1883);
+    const uint8_t connackAliases[] = {0x20, 6, 0, 0, 3, 0x22, 0, 10};
+    const uint8_t connackNoAliases[] = {0x20, 3, 0, 0, 0};
+    link.inject(connackAliases, sizeof(connackAliases));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+
+    const uint8_t value[] = {'7'};
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", value, sizeof(value), false, 1, 2));
+    CHECK(mqtt.inflight() == 1);
+    uint8_t idHigh = link.sent()[7];
+    uint8_t idLow = link.sent()[8];
+
+    // Same limit: resent as it was, DUP set, and the alias is known again
+    mqtt.disconnect();
+    link.inject(connackAliases, sizeof(connackAliases));
+    link.clearSent();
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    const std::vector<uint8_t> withAlias = {0x3A, 12, 0, 3, 'a', '/', 'b', idHigh, idLow, 3, 0x23, 0, 2, '7'};
+    CHECK(link.sent().size() > 18 &&
+          std::equal(withAlias.begin(), withAlias.end(), link.sent().end() - withAlias.size()));
+    link.clearSent();
+    CHECK(mqtt.publish("a/b", value, sizeof(value), false, 0, 2));
+    CHECK(link.sent() == std::vector<uint8_t>({0x30, 7, 0, 0, 3, 0x23, 0, 2, '7'}));
+
+    // No aliases on the new connection: the property is dropped
+    mqtt.disconnect();
+    link.inject(connackNoAliases, sizeof(connackNoAliases));
+    link.clearSent();
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    const std::vector<uint8_t> withoutAlias = {0x3A, 9, 0, 3, 'a', '/', 'b', idHigh, idLow, 0, '7'};
+    CHECK(link.sent().size() > 18 &&
+          std::equal(withoutAlias.begin(), withoutAlias.end(), link.sent().end() - withoutAlias.size()));
+
+    uint8_t puback[] = {0x40, 2, idHigh, idLow};
+    link.inject(puback, sizeof(puback));
+    mqtt.loop();
+    CHECK(mqtt.inflight() == 0);
+}
+
+static void testProtocolFallback()
+{
+    DecentIoTLoopbackTransport link;
+    DecentIoTMqtt mqtt(unusedSocket);
+    mqtt.setTransport(link).setServer("broker", 1883);
+
+    // A 3.1.1 broker refuses level 5 with 0x01; the same connect() retries with 4
+    const uint8_t refused[] = {0x20, 2, 0, 0x01};
+    const uint8_t accepted[] = {0x20, 2, 0, 0};
+    link.inject(refused, sizeof(refused));
+    link.inject(accepted, sizeof(accepted));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.protocolVersion() == 4);
+
+    // The next connection tries 5 again
+    mqtt.disconnect();
+    const uint8_t connackV5[] = {0x20, 3, 0, 0, 0};
+    link.inject(connackV5, sizeof(connackV5));
+    CHECK(mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.protocolVersion() == 5);
+
+    // No CONNACK at all is a timeout, not a refusal
+    mqtt.disconnect();
+    CHECK(!mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.state() == MQTT_CONNECTION_TIMEOUT);
+    CHECK(mqtt.protocolVersion() == 5);
+
+    // Link down: connect fails without touching the version
+    link.setLinkUp(false);
+    CHECK(!mqtt.connect("dev", nullptr, nullptr));
+    CHECK(mqtt.state() == MQTT_CONNECT_FAILED);
+}
+
+int main()
+{
+    testConnectV5();
+    testInboundAndQos1();
+    testTopicAliases();
+    testResendAfterAliasChange();
+    testProtocolFallback();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,231 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+static std::string dir;
+static std::string base;
+
+static void useLog(const char *name)
+{
+    base = dir + "/" + name;
+}
+
+static bool segmentExists(uint8_t segment)
+{
+    std::string path = base + "." + std::to_string(segment);
+    return access(path.c_str(), F_OK) == 0;
+}
+
+static uint32_t drain(DecentIoTOfflineLog &log, uint32_t &first)
+{
+    DecentIoTLogRecord record;
+    uint32_t count = 0;
+    while (log.peek(record))
+    {
+        if (count++ == 0)
+            first = record.value;
+        log.pop();
+    }
+    return count;
+}
+
+// 16 records over 8 segments: 2 per segment file
+static void testAppendAndReplay()
+{
+    useLog("replay");
+    DecentIoTFileStorage storage(base.c_str(), 16);
+    DecentIoTOfflineLog log;
+    CHECK(log.begin(&storage));
+    for (uint32_t i = 0; i < 10; i++)
+        CHECK(log.append(1, 1, 1000 + i, i));
+    CHECK(log.size() == 10);
+
+    DecentIoTLogRecord record;
+    CHECK(log.peek(record));
+    CHECK(record.value == 0 && record.timestamp == 1000 && record.pin == 1);
+    log.pop();
+    log.peek(record);
+    log.pop();
+    CHECK(!segmentExists(0)); // replayed segments are deleted whole
+    CHECK(segmentExists(1));
+
+    uint32_t first = 0;
+    CHECK(drain(log, first) == 8);
+    CHECK(first == 2);
+    CHECK(log.overwritten() == 0);
+}
+
+// Full: starting a segment drops the oldest one, two records at a time
+static void testRotation()
+{
+    useLog("rotate");
+    DecentIoTFileStorage storage(base.c_str(), 16);
+    DecentIoTOfflineLog log;
+    CHECK(log.begin(&storage));
+    for (uint32_t i = 0; i < 40; i++)
+        log.append(2, 1, 0, 100 + i);
+    log.flush();
+    CHECK(log.size() <= 16);
+    CHECK(log.size() + log.overwritten() == 40);
+
+    uint32_t first = 0;
+    uint32_t count = drain(log, first);
+    CHECK(first + count == 140); // the newest records survive, in order
+}
+
+// A reset resumes after the last checkpoint and keeps later appends in place
+static void testReopen()
+{
+    useLog("reopen");
+    {
+        DecentIoTFileStorage storage(base.c_str(), 16);
+        DecentIoTOfflineLog log;
+        CHECK(log.begin(&storage));
+        for (uint32_t i = 0; i < 6; i++)
+            log.append(3, 1, 0, 200 + i);
+        DecentIoTLogRecord record;
+        for (int i = 0; i < 2; i++)
+        {
+            log.peek(record);
+            log.pop(); // crossing into the next segment saves a checkpoint
+        }
+        log.flush();
+    }
+    DecentIoTFileStorage storage(base.c_str(), 16);
+    DecentIoTOfflineLog log;
+    CHECK(log.begin(&storage));
+    CHECK(log.size() == 4);
+    log.append(3, 1, 0, 206);
+    uint32_t first = 0;
+    CHECK(drain(log, first) == 5);
+    CHECK(first == 202);
+}
+
+// A torn append (power loss) loses at most the torn record
+static void testTornTail()
+{
+    useLog("torn");
+    uint32_t next;
+    {
+        DecentIoTFileStorage storage(base.c_str(), 16);
+        DecentIoTOfflineLog log;
+        CHECK(log.begin(&storage));
+        for (uint32_t i = 0; i < 3; i++)
+            log.append(4, 1, 0, 300 + i);
+        log.flush();
+        next = log.size();
+    }
+    CHECK(next == 3);
+    // Find the segment holding the newest record and add half a record
+    for (uint8_t segment = 0; segment < DECENTIOT_LOG_SEGMENTS; segment++)
+    {
+        std::string path = base + "." + std::to_string(segment);
+        FILE *f = fopen(path.c_str(), "rb");
+        if (f == nullptr)
+            continue;
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        if (size == (long)sizeof(DecentIoTLogRecord))
+        {
+            f = fopen(path.c_str(), "ab");
+            fwrite("torn", 1, 4, f);
+            fclose(f);
+        }
+    }
+
+    DecentIoTFileStorage storage(base.c_str(), 16);
+    DecentIoTOfflineLog log;
+    CHECK(log.begin(&storage));
+    log.append(4, 1, 0, 303);
+    uint32_t first = 0;
+    uint32_t count = drain(log, first);
+    CHECK(first == 300);
+    CHECK(count == 4);
+}
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+// Through the client: FIFO writes made offline are replayed in order on
+// reconnect, minus those older than the maximum age
+static void testClientReplay()
+{
+    useLog("client");
+    DecentIoTFileStorage storage(base.c_str(), 16);
+    HostBroker &broker = HostBroker::instance();
+    broker.up = false;
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setReconnectBackoff(100, 100);
+    DecentIoT.setQueueMode(P1, DECENTIOT_QUEUE_FIFO);
+    DecentIoT.setOfflineMaxAge(60);
+    CHECK(DecentIoT.setOfflineStorage(&storage));
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runFor(100);              // the clock syncs here
+    hostSetTimeSynced(false); // and then runs on millis() alone
+
+    DecentIoT.write(P1, 1);
+    runFor(120000, 1000); // two minutes: too old to replay
+    for (int i = 2; i <= 4; i++)
+        DecentIoT.write(P1, i);
+    CHECK(DecentIoT.getOfflineLogSize() == 4);
+
+    broker.up = true;
+    runFor(2000);
+    CHECK(DecentIoT.connected());
+    CHECK(DecentIoT.getOfflineLogSize() == 0);
+    CHECK(DecentIoT.getQueueDrops() == 1);
+    std::string replayed;
+    for (const HostMessage &message : broker.published)
+    {
+        if (message.topic == "project/users/uid/datastreams/device/P1/value")
+            replayed += message.payload;
+    }
+    CHECK_STR(replayed.c_str(), "234");
+}
+
+int main()
+{
+    char temp[] = "/tmp/decentiot-log-XXXXXX";
+    if (mkdtemp(temp) == nullptr)
+        return 1;
+    dir = temp;
+
+    testAppendAndReplay();
+    testRotation();
+    testReopen();
+    testTornTail();
+    testClientReplay();
+
+    if (system(("rm -rf " + dir).c_str()) != 0)
+        return 1;
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,137 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <string>
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+// Payloads published on a pin's value topic, joined by spaces
+static std::string sent(const char *pin)
+{
+    std::string name = std::string("project/users/uid/datastreams/device/") + pin + "/value";
+    std::string joined;
+    for (const HostMessage &message : HostBroker::instance().published)
+    {
+        if (message.topic != name)
+            continue;
+        if (!joined.empty())
+            joined += ' ';
+        joined += message.payload;
+    }
+    return joined;
+}
+
+static void testAbsoluteDeadband()
+{
+    DecentIoT.setDeadband(P1, 0.5f);
+    DecentIoT.write(P1, 20.0f);
+    DecentIoT.write(P1, 20.3f); // within 0.5 of 20
+    DecentIoT.write(P1, 20.6f);
+    DecentIoT.write(P1, 20.2f); // within 0.5 of 20.6
+    DecentIoT.write(P1, 19.0f);
+    CHECK_STR(sent("P1").c_str(), "20.0 20.6 19.0");
+}
+
+static void testPercentDeadband()
+{
+    DecentIoT.setDeadband(P2, 10.0f, DECENTIOT_DEADBAND_PERCENT);
+    DecentIoT.write(P2, 100);
+    DecentIoT.write(P2, 105);
+    DecentIoT.write(P2, 111);
+    DecentIoT.write(P2, 101); // 10% of 111 is 11.1
+    DecentIoT.write(P2, 99);
+    CHECK_STR(sent("P2").c_str(), "100 111 99");
+}
+
+// Changes inside minInterval are held back, and the newest goes out
+// once the interval is over, without another write()
+static void testMinInterval()
+{
+    DecentIoT.setPublishInterval(P3, 1000);
+    DecentIoT.write(P3, 1);
+    runFor(100);
+    DecentIoT.write(P3, 2);
+    DecentIoT.write(P3, 3);
+    CHECK_STR(sent("P3").c_str(), "1");
+    runFor(1000);
+    CHECK_STR(sent("P3").c_str(), "1 3");
+    runFor(2000);
+    CHECK_STR(sent("P3").c_str(), "1 3");
+}
+
+// An unchanged value is refreshed after maxSilence
+static void testMaxSilence()
+{
+    DecentIoT.setDeadband(P4, 1.0f);
+    DecentIoT.setPublishInterval(P4, 0, 5000);
+    DecentIoT.write(P4, true);
+    runFor(1000);
+    DecentIoT.write(P4, true);
+    CHECK_STR(sent("P4").c_str(), "true");
+    runFor(4500);
+    CHECK_STR(sent("P4").c_str(), "true true");
+}
+
+// Batched values only count as sent once the batch is published: a
+// refused batch leaves the deadband where it was
+static void testBatchSettles()
+{
+    HostBroker &broker = HostBroker::instance();
+    DecentIoT.setDeadband(P5, 1.0f);
+    broker.failPublish = true;
+    DecentIoT.beginBatch();
+    DecentIoT.add(P5, 10);
+    CHECK(!DecentIoT.commitBatch());
+    broker.failPublish = false;
+    runFor(100); // the requeued value goes out on its own
+    CHECK_STR(sent("P5").c_str(), "10");
+    DecentIoT.write(P5, 10);
+    CHECK_STR(sent("P5").c_str(), "10 10");
+
+    DecentIoT.beginBatch();
+    DecentIoT.add(P5, 20);
+    CHECK(DecentIoT.commitBatch());
+    DecentIoT.write(P5, 20);
+    CHECK_STR(sent("P5").c_str(), "10 10");
+}
+
+int main()
+{
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runFor(100);
+    CHECK(DecentIoT.connected());
+
+    testAbsoluteDeadband();
+    testPercentDeadband();
+    testMinInterval();
+    testMaxSilence();
+    testBatchSettles();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTRing.h"
+#include "HostTest.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static void testSpscOrderAndBounds()
+{
+    DecentIoTSpscRing<int, 4> ring{};
+    int item = 0;
+    CHECK(!ring.pop(item));
+    for (int i = 0; i < 4; i++)
+        CHECK(ring.push(i));
+    CHECK(!ring.push(99)); // full
+    CHECK(ring.size() == 4);
+
+    // Wrap around several times; order is kept throughout
+    int next = 0;
+    for (int i = 4; i < 40; i++)
+    {
+        CHECK(ring.pop(item));
+        CHECK(item == next++);
+        CHECK(ring.push(i));
+    }
+    while (ring.pop(item))
+        CHECK(item == next++);
+    CHECK(next == 40);
+    CHECK(ring.size() == 0);
+}
+
+static void testSpscAcrossThreads()
+{
+    static DecentIoTSpscRing<uint32_t, 64> ring;
+    const uint32_t count = 200000;
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < count; i++)
+            while (!ring.push(i))
+                std::this_thread::yield();
+    });
+    uint32_t expected = 0;
+    bool ordered = true;
+    while (expected < count)
+    {
+        uint32_t item;
+        if (!ring.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && item == expected;
+        expected++;
+    }
+    producer.join();
+    CHECK(ordered);
+}
+
+static void testMpscBounds()
+{
+    DecentIoTMpscRing<int, 8> ring;
+    int item = 0;
+    CHECK(!ring.pop(item));
+    for (int i = 0; i < 8; i++)
+        CHECK(ring.push(i));
+    CHECK(!ring.push(8));
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK(ring.pop(item));
+        CHECK(item == i);
+    }
+    CHECK(!ring.pop(item));
+}
+
+// Several producers at once: nothing lost or duplicated, and each
+// producer's items arrive in the order it pushed them
+static void testMpscAcrossThreads()
+{
+    struct Item
+    {
+        uint32_t producer;
+        uint32_t sequence;
+    };
+    static DecentIoTMpscRing<Item, 128> ring;
+    const uint32_t producers = 4;
+    const uint32_t perProducer = 50000;
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; p++)
+    {
+        threads.push_back(std::thread([p, perProducer]() {
+            for (uint32_t i = 0; i < perProducer; i++)
+            {
+                Item item = {p, i};
+                while (!ring.push(item))
+                    std::this_thread::yield();
+            }
+        }));
+    }
+
+    std::vector<uint32_t> next(producers, 0);
+    uint32_t received = 0;
+    bool ordered = true;
+    while (received < producers * perProducer)
+    {
+        Item item;
+        if (!ring.pop(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        ordered = ordered && item.producer < producers && item.sequence == next[item.producer];
+        next[item.producer]++;
+        received++;
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+    CHECK(ordered);
+    Item extra;
+    CHECK(!ring.pop(extra));
+}
+
+int main()
+{
+    testSpscOrderAndBounds();
+    testSpscAcrossThreads();
+    testMpscBounds();
+    testMpscAcrossThreads();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,176 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <WiFi.h>
+#include <string>
+
+// Calls run() every step ms until ms have passed
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+static void testPeriodicAndOnce()
+{
+    int periodic = 0;
+    int once = 0;
+    DecentIoTTaskId handle = DecentIoT.schedule(100, [&]() { periodic++; });
+    DecentIoT.scheduleOnce(250, [&]() { once++; });
+    runFor(1000);
+    CHECK(periodic == 10);
+    CHECK(once == 1);
+    CHECK(DecentIoT.getTaskJitter(handle).runs == 10);
+    CHECK(DecentIoT.getTaskJitter(handle).max == 0);
+
+    DecentIoT.cancel(handle);
+    runFor(500);
+    CHECK(periodic == 10);
+}
+
+static void testNamedTasks()
+{
+    std::string log;
+    DecentIoT.schedule("blink", 50, [&]() { log += 'a'; });
+    DecentIoT.schedule("blink", 50, [&]() { log += 'b'; }); // replaces the first
+    runFor(100);
+    CHECK_STR(log.c_str(), "bb");
+
+    DecentIoT.cancel("blink");
+    runFor(100);
+    CHECK_STR(log.c_str(), "bb");
+}
+
+// A handle to a cancelled task must not reach whatever reuses its slot
+static void testStaleHandles()
+{
+    int first = 0;
+    int second = 0;
+    DecentIoTTaskId stale = DecentIoT.scheduleOnce(10, [&]() { first++; });
+    DecentIoT.cancel(stale);
+    DecentIoTTaskId fresh = DecentIoT.scheduleOnce(10, [&]() { second++; });
+    CHECK(fresh != stale);
+    DecentIoT.cancel(stale);
+    runFor(20);
+    CHECK(first == 0);
+    CHECK(second == 1);
+}
+
+static void testPriorityAndReentrancy()
+{
+    std::string order;
+    DecentIoTTaskId low = DecentIoT.scheduleOnce(30, [&]() { order += 'L'; });
+    DecentIoTTaskId high = DecentIoT.scheduleOnce(30, [&]() { order += 'H'; });
+    DecentIoT.setPriority(low, DECENTIOT_PRIORITY_LOW);
+    DecentIoT.setPriority(high, DECENTIOT_PRIORITY_HIGH);
+    runFor(30, 30); // both due in the same run()
+    CHECK_STR(order.c_str(), "HL");
+
+    // A task may cancel itself and schedule others from its callback
+    int self = 0;
+    int spawned = 0;
+    DecentIoTTaskId handle = 0;
+    handle = DecentIoT.schedule(10, [&]() {
+        self++;
+        DecentIoT.cancel(handle);
+        DecentIoT.scheduleOnce(10, [&]() { spawned++; });
+    });
+    runFor(100);
+    CHECK(self == 1);
+    CHECK(spawned == 1);
+}
+
+// With a budget, run() stops dispatching once it is spent; the rest stay due
+// and go first on the next call, and their lateness shows up as jitter
+static void testBudget()
+{
+    std::string order;
+    DecentIoTTaskId slow = DecentIoT.scheduleOnce(20, [&]() { order += 'S'; delay(2); });
+    DecentIoTTaskId control = DecentIoT.scheduleOnce(20, [&]() { order += 'C'; delay(2); });
+    DecentIoTTaskId telemetry = DecentIoT.scheduleOnce(20, [&]() { order += 'T'; delay(2); });
+    DecentIoT.setPriority(control, DECENTIOT_PRIORITY_HIGH);
+    DecentIoT.setPriority(telemetry, DECENTIOT_PRIORITY_LOW);
+    (void)slow;
+
+    hostAdvanceMillis(20);
+    DecentIoT.run(1000);
+    CHECK_STR(order.c_str(), "C");
+    DecentIoT.run(1000);
+    CHECK_STR(order.c_str(), "CS");
+    DecentIoT.run(1000);
+    CHECK_STR(order.c_str(), "CST");
+
+    // A deferred periodic task keeps its deadline, so the wait shows up as
+    // lateness in its jitter
+    int ticks = 0;
+    DecentIoTTaskId periodic = DecentIoT.schedule("tick", 10, [&]() { ticks++; });
+    DecentIoT.setPriority(periodic, DECENTIOT_PRIORITY_LOW);
+    DecentIoT.run(); // first run falls due at once (interval counts from boot)
+    CHECK(ticks == 1);
+    DecentIoTTaskId hog = DecentIoT.scheduleOnce(10, [&]() { delay(5); });
+    DecentIoT.setPriority(hog, DECENTIOT_PRIORITY_HIGH);
+    hostAdvanceMillis(10);
+    DecentIoT.run(1000);
+    CHECK(ticks == 1);
+    DecentIoT.run(1000);
+    CHECK(ticks == 2);
+    CHECK(DecentIoT.getTaskJitter("tick").runs == 2);
+    CHECK(DecentIoT.getTaskJitter("tick").last == 5);
+
+    // No budget: everything due runs in one call
+    order.clear();
+    DecentIoT.cancel(periodic);
+    for (int i = 0; i < 3; i++)
+        DecentIoT.scheduleOnce(10, [&]() { order += 'x'; delay(2); });
+    hostAdvanceMillis(10);
+    DecentIoT.run();
+    CHECK_STR(order.c_str(), "xxx");
+}
+
+// millis() wraps after ~49 days; the scheduler's 64-bit clock must not
+static void testMillisWrap()
+{
+    hostSetMillis(0xFFFFFFFFUL - 495);
+    DecentIoT.run();
+    int runs = 0;
+    DecentIoTTaskId handle = DecentIoT.schedule(100, [&]() { runs++; });
+    runFor(1000);
+    CHECK(millis() < 1000); // wrapped
+    CHECK(runs >= 10 && runs <= 11);
+    DecentIoT.cancel(handle);
+}
+
+int main()
+{
+    WiFi.setStatus(WL_DISCONNECTED); // tasks run while offline too
+    hostSetMillis(0);
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+
+    testPeriodicAndOnce();
+    testNamedTasks();
+    testStaleHandles();
+    testPriorityAndReentrancy();
+    testBudget();
+    testMillisWrap();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,181 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "DecentIoTSeries.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <random>
+#include <string>
+#include <vector>
+
+static void testIntBlock()
+{
+    DecentIoTSeriesEncoder encoder;
+    std::vector<uint32_t> times;
+    std::vector<int32_t> values;
+    std::mt19937 random(7);
+    uint32_t t = 4000000000U; // wraps past 2^32 during the block
+    int32_t value = 1000;
+    while (true)
+    {
+        t += 1000 + random() % 5; // steady rate with a little jitter
+        value += (int32_t)(random() % 21) - 10;
+        if (!encoder.add(t, value))
+            break;
+        times.push_back(t);
+        values.push_back(value);
+    }
+    CHECK(encoder.count() == values.size());
+    CHECK(values.size() > DECENTIOT_SERIES_BLOCK_SIZE / 4); // a few bytes per sample
+    CHECK(!encoder.add(t, 1.5f));                            // other type
+
+    size_t length;
+    const uint8_t *block = encoder.finish(1700000000000ULL, true, length);
+    DecentIoTSeriesReader reader;
+    CHECK(reader.begin(block, length));
+    CHECK(reader.type() == DecentIoTSeriesEncoder::INT);
+    CHECK(reader.epoch());
+    CHECK(reader.count() == values.size());
+
+    bool same = true;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        uint64_t timestamp;
+        int32_t read;
+        if (!reader.next(timestamp, read))
+        {
+            same = false;
+            break;
+        }
+        same = same && read == values[i] && timestamp == 1700000000000ULL + (uint32_t)(times[i] - times[0]);
+    }
+    CHECK(same);
+    uint64_t timestamp;
+    int32_t read;
+    CHECK(!reader.next(timestamp, read));
+}
+
+static void testFloatBlock()
+{
+    DecentIoTSeriesEncoder encoder;
+    std::vector<float> values;
+    for (int i = 0; i < 50; i++)
+    {
+        float value = 20.0f + (i % 7) * 0.25f;
+        if (i == 10)
+            value = -1e30f;
+        CHECK(encoder.add(1000 + i * 500, value));
+        values.push_back(value);
+    }
+    CHECK(!encoder.add(30000, 5));
+
+    size_t length;
+    const uint8_t *block = encoder.finish(5000, false, length);
+    DecentIoTSeriesReader reader;
+    CHECK(reader.begin(block, length));
+    CHECK(reader.type() == DecentIoTSeriesEncoder::FLOAT);
+    CHECK(!reader.epoch());
+    bool same = true;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        uint64_t timestamp;
+        float read;
+        same = same && reader.next(timestamp, read) && read == values[i] && timestamp == 5000 + i * 500;
+    }
+    CHECK(same);
+
+    // A truncated block reads what is complete and then stops
+    DecentIoTSeriesReader truncated;
+    CHECK(truncated.begin(block, length - 3));
+    size_t readable = 0;
+    uint64_t timestamp;
+    float read;
+    while (truncated.next(timestamp, read))
+        readable++;
+    CHECK(readable < values.size());
+}
+
+static void testReset()
+{
+    DecentIoTSeriesEncoder encoder;
+    CHECK(encoder.add(0, 1));
+    encoder.reset();
+    CHECK(encoder.count() == 0);
+    CHECK(encoder.add(0, 2.0f)); // the type is free again
+
+    DecentIoTSeriesReader reader;
+    uint8_t garbage[] = {0x7F, 0x01};
+    CHECK(!reader.begin(garbage, sizeof(garbage)));
+}
+
+// Writes to a buffered pin go out as one block on "<pin>/block", here on the
+// highest pin, whose suffix is the longest
+static void testClientBlocks()
+{
+    HostBroker &broker = HostBroker::instance();
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    for (int i = 0; i < 200 && !DecentIoT.connected(); i++)
+    {
+        hostAdvanceMillis(10);
+        DecentIoT.run();
+    }
+    hostAdvanceMillis(10);
+    DecentIoT.run();
+    CHECK(DecentIoT.connected());
+
+    CHECK(DecentIoT.setSampleBuffer("P50", 4));
+    broker.published.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        DecentIoT.write(P50, 100 + i);
+        hostAdvanceMillis(250);
+    }
+    CHECK(broker.published.size() == 1);
+    if (broker.published.size() != 1)
+        return;
+    const HostMessage &message = broker.published[0];
+    CHECK(message.topic == "project/users/uid/datastreams/device/P50/block");
+
+    DecentIoTSeriesReader reader;
+    CHECK(reader.begin(reinterpret_cast<const uint8_t *>(message.payload.data()), message.payload.size()));
+    CHECK(reader.count() == 4);
+    bool same = true;
+    uint64_t first = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t timestamp;
+        int32_t read;
+        same = same && reader.next(timestamp, read) && read == 100 + i;
+        if (i == 0)
+            first = timestamp;
+        same = same && timestamp - first == (uint64_t)i * 250;
+    }
+    CHECK(same);
+}
+
+int main()
+{
+    testIntBlock();
+    testFloatBlock();
+    testReset();
+    testClientBlocks();
+    return HOST_TEST_RESULT();
+}
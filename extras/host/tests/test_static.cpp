@@ -0,0 +1,145 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+// Built with DECENTIOT_MAX_PINS / DECENTIOT_MAX_TASKS: after begin(), the
+// library must not touch the heap at all, whatever the sketch does
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <malloc.h>
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+
+static bool counting = false;
+static unsigned long allocations = 0;
+
+// operator new ends up here as well
+extern "C" void *malloc(size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(p, size);
+}
+
+static int received = 0;
+static int taskRuns = 0;
+static int onceRuns = 0;
+
+static void onP1(const DecentIoTValue &value)
+{
+    received += (int)value > 0 ? 1 : 0;
+}
+
+static void onTask()
+{
+    taskRuns++;
+}
+
+static void onOnce()
+{
+    onceRuns++;
+}
+
+static void runUntilConnected()
+{
+    for (int i = 0; i < 10000 && !DecentIoT.connected(); i++)
+    {
+        hostAdvanceMillis(10);
+        DecentIoT.run();
+    }
+    hostAdvanceMillis(10);
+    DecentIoT.run();
+}
+
+int main()
+{
+    HostBroker &broker = HostBroker::instance();
+    broker.record = false;
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setReconnectBackoff(10, 100);
+    DecentIoT.setQueueMode(P3, DECENTIOT_QUEUE_FIFO);
+    DecentIoT.setDeadband(P4, 0.5f);
+    DecentIoT.onReceive(P1, onP1);
+    DecentIoT.schedule("tick", 100, onTask);
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    runUntilConnected();
+    CHECK(DecentIoT.connected());
+
+    const char *topic = "project/users/uid/datastreams/device/P1/value";
+    counting = true;
+    for (int i = 0; i < 20000; i++)
+    {
+        DecentIoT.write(P2, i);
+        DecentIoT.write(P3, i * 0.25f);
+        DecentIoT.write(P4, (float)(i % 7));
+        DecentIoT.write(P5, "text");
+        broker.deliver(topic, "17");
+        if (i % 10 == 0)
+        {
+            DecentIoT.beginBatch();
+            DecentIoT.add(P6, i);
+            DecentIoT.add(P7, "a\"b");
+            DecentIoT.commitBatch();
+            DecentIoT.scheduleOnce(5, onOnce);
+        }
+        if (i % 5000 == 4999)
+        {
+            // Offline for a while, then a full reconnect and queue replay
+            broker.drop();
+            broker.up = false;
+            for (int j = 0; j < 20; j++)
+            {
+                DecentIoT.write(P3, (float)j);
+                hostAdvanceMillis(10);
+                DecentIoT.run();
+            }
+            broker.up = true;
+            runUntilConnected();
+        }
+        hostAdvanceMillis(1);
+        DecentIoT.run();
+    }
+    counting = false;
+
+    CHECK(allocations == 0);
+    CHECK(received == 20000);
+    CHECK(taskRuns > 0);
+    CHECK(onceRuns == 2000);
+    CHECK(DecentIoT.connected());
+    if (allocations != 0)
+        printf("%lu allocations after begin()\n", allocations);
+    return HOST_TEST_RESULT();
+}
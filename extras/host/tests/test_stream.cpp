@@ -0,0 +1,125 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+#include "HostTest.h"
+
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <string>
+
+// This device has stream handlers only, no onReceive()
+static const std::string kPrefix = "project/users/uid/datastreams/device/";
+
+static void runFor(unsigned long ms, unsigned long step = 10)
+{
+    for (unsigned long elapsed = 0; elapsed < ms; elapsed += step)
+    {
+        hostAdvanceMillis(step);
+        DecentIoT.run();
+    }
+}
+
+static bool runUntilConnected()
+{
+    for (int i = 0; i < 2000 && !DecentIoT.connected(); i++)
+        runFor(10);
+    runFor(10);
+    return DecentIoT.connected();
+}
+
+static size_t countOn(const std::string &topic)
+{
+    size_t count = 0;
+    for (const HostMessage &message : HostBroker::instance().published)
+        count += message.topic == topic;
+    return count;
+}
+
+static void testSubscriptions()
+{
+    HostBroker &broker = HostBroker::instance();
+    CHECK(broker.subscriptions.size() == 2 && broker.subscriptions[0] == kPrefix + "P6/value" &&
+          broker.subscriptions[1] == kPrefix + "P7/value");
+
+    DecentIoT.setSubscribeMode(DECENTIOT_SUBSCRIBE_WILDCARD);
+    broker.drop();
+    broker.subscriptions.clear();
+    CHECK(runUntilConnected());
+    CHECK(broker.subscriptions.size() == 1 && broker.subscriptions[0] == kPrefix + "+/value");
+}
+
+// A message that fits the MQTT buffer arrives as one piece
+static void testReceive(std::string &received, int &pieces)
+{
+    HostBroker &broker = HostBroker::instance();
+    CHECK(broker.deliver((kPrefix + "P6/value").c_str(), "firmware-chunk"));
+    CHECK(broker.deliver((kPrefix + "P8/value").c_str(), "no handler"));
+    runFor(10);
+    CHECK_STR(received.c_str(), "firmware-chunk");
+    CHECK(pieces == 1);
+}
+
+// A status publish must not land inside an open beginPublish() payload
+static void testBeginPublish()
+{
+    HostBroker &broker = HostBroker::instance();
+    const std::string status = kPrefix + "status";
+    broker.published.clear();
+    CHECK(DecentIoT.beginPublish(P9, 10));
+    CHECK(DecentIoT.append("hello") == 5);
+    DecentIoT.publishStatus("busy");
+    runFor(100);
+    CHECK(countOn(status) == 0);
+    CHECK(!DecentIoT.beginPublish(P10, 1)); // one at a time
+    CHECK(DecentIoT.append("world!") == 5); // capped at the declared length
+    CHECK(DecentIoT.endPublish());
+    CHECK(broker.published.size() == 1 && broker.published[0].topic == kPrefix + "P9/value" &&
+          broker.published[0].payload == "helloworld" && broker.published[0].retained);
+
+    DecentIoT.publishStatus("idle");
+    CHECK(countOn(status) == 1);
+
+    // Ending short drops the connection rather than corrupt the next packet
+    CHECK(DecentIoT.beginPublish(P9, 10));
+    CHECK(DecentIoT.append("short") == 5);
+    CHECK(!DecentIoT.endPublish());
+    CHECK(countOn(kPrefix + "P9/value") == 1);
+    CHECK(runUntilConnected());
+}
+
+int main()
+{
+    std::string received;
+    int pieces = 0;
+    WiFi.setStatus(WL_CONNECTED);
+    DecentIoT.setReconnectBackoff(100, 100);
+    DecentIoT.onReceiveStream("P6", [&](const DecentIoTChunk &chunk) {
+        if (chunk.first())
+            received.clear();
+        received.append(reinterpret_cast<const char *>(chunk.data), chunk.length);
+        pieces++;
+    });
+    DecentIoT.onReceiveStream("P7", [](const DecentIoTChunk &) {});
+    DecentIoT.begin("broker.local", 8883, "user", "pass", "project", "uid", "device");
+    CHECK(runUntilConnected());
+
+    testSubscriptions();
+    testReceive(received, pieces);
+    testBeginPublish();
+    return HOST_TEST_RESULT();
+}
@@ -24,8 +24,30 @@ DecentIoTClass DecentIoT;
 DecentIoTClass &getDecentIoT() { return DecentIoT; }
 
 DecentIoTClass::DecentIoTClass() : _port(1883),
-                                   _pubsub(_client)
+                                   _pubsub(_client),
+                                   _schedulerClock(0),
+                                   _schedulerLastMillis(0),
+                                   _queueHead(0),
+                                   _queueCount(0),
+                                   _fifoPins(0),
+                                   _queueDrops(0),
+                                   _drainRate(10),
+                                   _lastDrain(0),
+                                   _offlineMaxAge(DECENTIOT_OFFLINE_MAX_AGE),
+                                   _batchLen(0),
+                                   _batching(false),
+                                   _subscribeMode(DECENTIOT_SUBSCRIBE_PER_PIN),
+                                   _topicBuf(nullptr),
+                                   _topicPrefixLen(0)
 {
+    memset(_receiveSlot, 0, sizeof(_receiveSlot));
+    memset(_pinPrecision, -1, sizeof(_pinPrecision));
+    memset(_policySlot, 0, sizeof(_policySlot));
+    memset(_sampleSlot, 0, sizeof(_sampleSlot));
+    memset(_deviceTable, 0, sizeof(_deviceTable));
+#if DECENTIOT_NATIVE_MQTT
+    memset(_topicAlias, 0, sizeof(_topicAlias));
+#endif
 #ifdef ESP8266
     _cert = nullptr;
 #endif
@@ -41,451 +63,2649 @@ void DecentIoTClass::begin(const char *mqttBroker, int mqttPort, const char *mqt
     _port = mqttPort;
     _username = mqttUser;
     _password = mqttPass;
+    _buildTopicTable();
 
-    // Sync time with NTP server (same as Firebase library)
+    // Start NTP in the background (same servers as the Firebase library).
+    // Nothing waits here: run() connects as soon as a valid time is known.
     configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-    Serial.println("[DecentIoT] Waiting for NTP time sync...");
-    time_t now = 0;
-    int retry = 0;
-    while (now < 24 * 3600 && retry < 10) {
-        Serial.print(".");
-        delay(500);
-        now = time(nullptr);
-        retry++;
-    }
-    Serial.println();
-    if (now > 24 * 3600) {
-        Serial.printf("[DecentIoT] Time synced: %s", ctime(&now));
-    } else {
-        Serial.println("[DecentIoT] Failed to sync time");
-    }
+    _timeSyncRequested = true;
+    _timeSyncStart = millis();
 
     // MQTT over TLS using PubSubClient (port 8883)
-#ifdef ESP8266
-    if (_cert == nullptr)
-    {
-        _cert = new BearSSL::X509List(root_ca);
-        _client.setTrustAnchors(_cert);
-        _client.setInsecure(); // For testing
-    }
-#elif defined(ESP32)
-    _client.setCACert(root_ca);
-#endif
-    
-    // Set up PubSubClient with larger buffer for reliability
-    _pubsub.setBufferSize(512); // Increase from default 256 bytes
-    _pubsub.setServer(_broker.c_str(), _port);
-    _pubsub.setCallback([this](char* topic, byte* payload, unsigned int length) {
-        _handleMessage(topic, payload, length);
-    });
-    
-    String clientId = "DecentIoT-" + String(random(0xffff), HEX);
-    
-    // Try to connect with proper error handling
+    _configureClient();
+
     Serial.println("🔗 Connecting to MQTT broker via TLS...");
-    Serial.printf("[DecentIoT] Client ID: %s\n", clientId.c_str());
-    
-    if (_pubsub.connect(clientId.c_str(), _username.c_str(), _password.c_str())) {
-        Serial.println("✅ MQTT TLS connection successful");
-        _subscribeAllPubSub();
-        _publishDeviceStatus(true); // true = online
-        _wasWiFiConnected = true; // Mark WiFi as connected after successful MQTT connection
-    } else {
-        Serial.println("❌ MQTT TLS connection failed");
-        Serial.printf("[DecentIoT] Connection state: %d\n", _pubsub.state());
-        Serial.println("[DecentIoT] State codes: -4=timeout, -3=lost, -2=failed, -1=disconnected");
-        Serial.println("[DecentIoT] 1=bad protocol, 2=bad client ID, 3=unavailable, 4=bad credentials, 5=unauthorized");
+    if (WiFi.status() == WL_CONNECTED)
+    {
+        // Skip the settle delay of a WiFi reconnect, the socket is fresh
+        _wasWiFiConnected = true;
+        _connState = CONN_TIME_SYNC;
+        _connectionWait(0);
     }
 }
 
 void DecentIoTClass::onReceive(const char *pin, ReceiveCallback callback)
 {
-    _receiveHandlers.push_back({pin, callback});
+    _addReceiveHandler(_receiveHandlers, _receiveSlot, _pinIndex(pin, strlen(pin)), pin, callback);
     // For PubSubClient, subscribe after connection!
 }
 
-void DecentIoTClass::onSend(const char *pin, SendCallback callback)
+void DecentIoTClass::onReceive(DecentIoTPin pin, ReceiveCallback callback)
 {
-    _sendHandlers.push_back({pin, callback});
-    // Optionally, implement scheduling if needed
+    _addReceiveHandler(_receiveHandlers, _receiveSlot, pin.id, pin.name, callback);
 }
 
-String DecentIoTClass::_getTopic(const char *pin) const
+void DecentIoTClass::onReceiveStream(const char *pin, ReceiveStreamCallback callback)
 {
-    return _projectId + "/users/" + _userId + "/datastreams/" + _deviceId + "/" + pin + "/value";
+    if (strlen(pin) > DECENTIOT_MAX_PIN_NAME || _streamHandlers.size() >= _streamHandlers.max_size())
+    {
+        Serial.printf("[DecentIoT] Cannot register stream handler for %s\n", pin);
+        return;
+    }
+    ReceiveStreamHandler handler;
+    strcpy(handler.id, pin);
+    handler.callback = callback;
+    _streamHandlers.push_back(handler);
 }
 
-void DecentIoTClass::_handleMessage(const char *topic, const uint8_t *payload, unsigned int length)
+// Shared by this device and gateway devices, each with its own table
+void DecentIoTClass::_addReceiveHandler(ReceiveHandlerList &handlers, uint8_t *slots, int pinIndex,
+                                        const char *pin, ReceiveCallback callback)
 {
-    String topicStr(topic);
-    //String pin = topicStr.substring(topicStr.lastIndexOf('/') + 1); // if not upto value
-    int lastSlash = topicStr.lastIndexOf('/');
-    int secondLastSlash = topicStr.lastIndexOf('/', lastSlash - 1);
-    String pin = topicStr.substring(secondLastSlash + 1, lastSlash);
-    String message;
-    for (unsigned int i = 0; i < length; ++i)
-        message += (char)payload[i];
-
-    // Try to parse as bool, int, float, string (in that order)
-    DecentIoTValue v;
-    if (message == "true" || message == "false")
-    {
-        v.type = DecentIoTValue::BOOL;
-        v.boolValue = (message == "true");
-    }
-    else if (message.length() > 0 && isNumericString(message))
+    if (strlen(pin) > DECENTIOT_MAX_PIN_NAME || handlers.size() >= handlers.max_size())
     {
-        v.type = DecentIoTValue::INT;
-        v.intValue = message.toInt();
+        Serial.printf("[DecentIoT] Cannot register receive handler for %s\n", pin);
+        return;
     }
-    else if (message.indexOf('.') != -1 && message.toFloat() != 0.0f)
+    ReceiveHandler handler;
+    strcpy(handler.id, pin);
+    handler.callback = callback;
+    handlers.push_back(handler);
+    // First registration for a pin wins, matching the old linear lookup
+    if (pinIndex >= 0 && pinIndex < DECENTIOT_PIN_COUNT && slots[pinIndex] == 0 &&
+        handlers.size() <= UINT8_MAX)
     {
-        v.type = DecentIoTValue::FLOAT;
-        v.floatValue = message.toFloat();
+        slots[pinIndex] = handlers.size();
     }
-    else
+}
+
+ReceiveHandler *DecentIoTClass::_findReceiveHandler(ReceiveHandlerList &handlers, const uint8_t *slots,
+                                                    const char *pin, size_t pinLen)
+{
+    int index = _pinIndex(pin, pinLen);
+    if (index >= 0)
     {
-        v.type = DecentIoTValue::STRING;
-        v.stringValue = message;
+        size_t slot = slots[index];
+        if (slot == 0 || slot > handlers.size())
+            return nullptr;
+        return &handlers[slot - 1];
     }
-    for (auto &handler : _receiveHandlers)
+
+    // Custom pin names
+    for (auto &handler : handlers)
     {
-        if (handler.id == pin)
-        {
-            handler.callback(v);
-            break;
-        }
+        if (strlen(handler.id) == pinLen && memcmp(handler.id, pin, pinLen) == 0)
+            return &handler;
     }
+    return nullptr;
 }
 
-void DecentIoTClass::write(const char *pin, bool value)
+// Returns 0..50 for "P0".."P50", -1 for anything else
+int DecentIoTClass::_pinIndex(const char *pin, size_t pinLen)
 {
-    String topic = _getTopic(pin);
-    const char *payload = value ? "true" : "false";
-    if (_pubsub.connected())
+    if (pinLen < 2 || pinLen > 3 || pin[0] != 'P')
+        return -1;
+    if (pinLen == 3 && pin[1] == '0')
+        return -1; // "P05" is a custom name, not P5
+    int index = 0;
+    for (size_t i = 1; i < pinLen; i++)
     {
-        _pubsub.publish(topic.c_str(), payload, true);
+        if (pin[i] < '0' || pin[i] > '9')
+            return -1;
+        index = index * 10 + (pin[i] - '0');
     }
-    else
+    return index < DECENTIOT_PIN_COUNT ? index : -1;
+}
+
+void DecentIoTClass::onSend(const char *pin, SendCallback callback)
+{
+    if (strlen(pin) > DECENTIOT_MAX_PIN_NAME || _sendHandlers.size() >= _sendHandlers.max_size())
     {
-        Serial.println("⚠️  MQTT not connected, skipping message");
+        Serial.printf("[DecentIoT] Cannot register send handler for %s\n", pin);
+        return;
     }
+    SendHandler handler;
+    strcpy(handler.id, pin);
+    handler.callback = callback;
+    _sendHandlers.push_back(handler);
+    // Optionally, implement scheduling if needed
 }
-void DecentIoTClass::write(const char *pin, int value)
+
+void DecentIoTClass::_buildTopicTable()
+{
+    String prefix = _projectId + "/users/" + _userId + "/datastreams/" + _deviceId + "/";
+    _topicPrefixLen = prefix.length();
+
+    // Room for the longest suffix: "<pin>/value" or "status"
+    delete[] _topicBuf;
+    _topicBuf = new char[_topicPrefixLen + DECENTIOT_MAX_PIN_NAME + sizeof("/value")];
+    memcpy(_topicBuf, prefix.c_str(), _topicPrefixLen + 1);
+    _datastreamsLen = _topicPrefixLen - _deviceId.length() - 1;
+
+    // Gateway devices added before begin() get their prefix now
+    for (auto device : _devices)
+        _buildDeviceTopic(*device);
+}
+
+const char *DecentIoTClass::_getTopic(const char *pin)
 {
-    String topic = _getTopic(pin);
-    char buffer[16];
-    sprintf(buffer, "%d", value);
-    if (_pubsub.connected())
+    return _pinTopic(_topicBuf, _topicPrefixLen, pin);
+}
+
+// Device-level topics such as "<prefix>status" and "<prefix>batch"
+const char *DecentIoTClass::_getDeviceTopic(const char *suffix)
+{
+    return _suffixTopic(_topicBuf, _topicPrefixLen, suffix);
+}
+
+// Patches "<pin>/value" in after the prefix of a topic buffer
+const char *DecentIoTClass::_pinTopic(char *topicBuf, size_t prefixLen, const char *pin)
+{
+    if (topicBuf == nullptr)
+        return nullptr;
+    size_t pinLen = strlen(pin);
+    if (pinLen > DECENTIOT_MAX_PIN_NAME)
     {
-        _pubsub.publish(topic.c_str(), buffer, true);
+        Serial.printf("[DecentIoT] Pin name too long: %s\n", pin);
+        return nullptr;
     }
-    else
+    char *suffix = topicBuf + prefixLen;
+    memcpy(suffix, pin, pinLen);
+    memcpy(suffix + pinLen, "/value", sizeof("/value"));
+    return topicBuf;
+}
+
+const char *DecentIoTClass::_suffixTopic(char *topicBuf, size_t prefixLen, const char *suffix)
+{
+    size_t suffixLen = strlen(suffix);
+    if (topicBuf == nullptr || suffixLen > DECENTIOT_MAX_PIN_NAME + sizeof("/value") - 1)
+        return nullptr;
+    memcpy(topicBuf + prefixLen, suffix, suffixLen + 1);
+    return topicBuf;
+}
+
+// Value topic of a pin on this device (0) or on gateway device n
+const char *DecentIoTClass::_topicFor(uint8_t device, const char *pin)
+{
+    if (device == 0)
+        return _getTopic(pin);
+    if (device > _devices.size())
+        return nullptr;
+    DecentIoTDevice *target = _devices[device - 1];
+    return _pinTopic(target->_topicBuf, target->_topicPrefixLen, pin);
+}
+
+void DecentIoTClass::_handleMessage(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    // Only accept "<our prefix><pin>/value" or "<our prefix>batch/set"; the
+    // prefix is the head of _topicBuf
+    _messagesRead++;
+    size_t topicLen = strlen(topic);
+    if (_topicBuf == nullptr || topicLen <= _datastreamsLen)
+        return;
+    if (topicLen > _topicPrefixLen && memcmp(topic, _topicBuf, _topicPrefixLen) == 0)
     {
-        Serial.println("⚠️  MQTT not connected, skipping message");
+        if (strcmp(topic + _topicPrefixLen, "batch/set") == 0)
+        {
+            _handleBatch(payload, length);
+            return;
+        }
+        _dispatch(0, topic + _topicPrefixLen, topicLen - _topicPrefixLen, payload, length);
+        return;
     }
+
+    // Gateway device: "<project>/users/<user>/datastreams/<id>/<pin>/value"
+    if (_devices.empty() || memcmp(topic, _topicBuf, _datastreamsLen) != 0)
+        return;
+    const char *id = topic + _datastreamsLen;
+    const char *slash = static_cast<const char *>(memchr(id, '/', topicLen - _datastreamsLen));
+    if (slash == nullptr)
+        return;
+    DecentIoTDevice *device = _findDevice(id, slash - id);
+    if (device == nullptr)
+        return;
+    _dispatch(device->_index, slash + 1, topic + topicLen - slash - 1, payload, length);
 }
-void DecentIoTClass::write(const char *pin, float value)
+
+// Finds the handler for "<pin>/value" on this device (0) or gateway device n
+void DecentIoTClass::_dispatch(uint8_t device, const char *pinTopic, size_t pinTopicLen,
+                               const uint8_t *payload, unsigned int length)
 {
-    String topic = _getTopic(pin);
-    char buffer[16];
-    sprintf(buffer, "%f", value);
-    if (_pubsub.connected())
+    const size_t suffixLen = sizeof("/value") - 1;
+    if (pinTopicLen <= suffixLen || memcmp(pinTopic + pinTopicLen - suffixLen, "/value", suffixLen) != 0)
+        return;
+
+    ReceiveHandler *handler;
+    if (device == 0)
     {
-        _pubsub.publish(topic.c_str(), buffer, true);
+        handler = _findReceiveHandler(_receiveHandlers, _receiveSlot, pinTopic, pinTopicLen - suffixLen);
     }
     else
     {
-        Serial.println("⚠️  MQTT not connected, skipping message");
+        DecentIoTDevice *target = _devices[device - 1];
+        handler = _findReceiveHandler(target->_receiveHandlers, target->_receiveSlot, pinTopic, pinTopicLen - suffixLen);
     }
-}
-void DecentIoTClass::write(const char *pin, const char *value)
-{
-    String topic = _getTopic(pin);
-    if (_pubsub.connected())
+    if (handler != nullptr)
     {
-        _pubsub.publish(topic.c_str(), value, true);
+        _deliver(handler, payload, length, device);
+        return;
     }
-    else
+    // A message that fit the MQTT buffer reaches a stream handler in one piece
+    ReceiveStreamHandler *stream = device == 0 ? _findStreamHandler(pinTopic, pinTopicLen) : nullptr;
+    if (stream != nullptr)
     {
-        Serial.println("⚠️  MQTT not connected, skipping message");
+        DECENTIOT_STAT(_pinStats(stream->id).received++);
+        DECENTIOT_STAT(_pinStats(stream->id).bytesReceived += length);
+        DecentIoTChunk chunk = {payload, length, 0, length};
+        stream->callback(chunk);
     }
 }
 
-void DecentIoTClass::publishStatus(const char *status)
+// Stream handler for "<pin>/value" on this device
+ReceiveStreamHandler *DecentIoTClass::_findStreamHandler(const char *pinTopic, size_t pinTopicLen)
 {
-    String topic = _projectId + "/users/" + _userId + "/datastreams/" + _deviceId + "/status";
-    if (_pubsub.connected())
+    size_t pinLen = pinTopicLen - (sizeof("/value") - 1);
+    for (auto &handler : _streamHandlers)
     {
-        _pubsub.publish(topic.c_str(), status, true);
+        if (strlen(handler.id) == pinLen && memcmp(handler.id, pinTopic, pinLen) == 0)
+            return &handler;
     }
-    else
+    return nullptr;
+}
+
+// Piece of a message too large for the MQTT buffer (native client only)
+void DecentIoTClass::_handleStream(const char *topic, const uint8_t *data, size_t length, size_t offset, size_t total)
+{
+    _messagesRead++;
+    size_t topicLen = strlen(topic);
+    const size_t suffixLen = sizeof("/value") - 1;
+    if (_topicBuf == nullptr || topicLen <= _topicPrefixLen + suffixLen ||
+        memcmp(topic, _topicBuf, _topicPrefixLen) != 0 || strcmp(topic + topicLen - suffixLen, "/value") != 0)
+        return;
+    ReceiveStreamHandler *stream = _findStreamHandler(topic + _topicPrefixLen, topicLen - _topicPrefixLen);
+    if (stream == nullptr)
+        return;
+    DECENTIOT_STAT(_pinStats(stream->id).received += offset == 0 ? 1 : 0);
+    DECENTIOT_STAT(_pinStats(stream->id).bytesReceived += length);
+    DecentIoTChunk chunk = {data, length, offset, total};
+    stream->callback(chunk);
+}
+
+// Calls the handler, or with the network task running hands the value to run()
+void DecentIoTClass::_deliver(ReceiveHandler *handler, const uint8_t *payload, unsigned int length, uint8_t device)
+{
+    DECENTIOT_STAT(_pinStats(handler->id).received++);
+    DECENTIOT_STAT(_pinStats(handler->id).bytesReceived += length);
+#if DECENTIOT_NETWORK_TASK
+    if (_networkThread.running())
     {
-        Serial.println("⚠️  MQTT not connected, skipping status");
+        if (length > DECENTIOT_MAX_INBOUND_PAYLOAD)
+        {
+            _ringDrops++;
+            return;
+        }
+        InboundMessage msg;
+        msg.device = device;
+        msg.handler = handler - (device == 0 ? &_receiveHandlers[0] : &_devices[device - 1]->_receiveHandlers[0]);
+        msg.length = length;
+        memcpy(msg.payload, payload, length);
+        msg.payload[length] = '\0';
+        if (!_inbound.push(msg))
+            _ringDrops++;
+        return;
     }
+#endif
+    // The payload stays in PubSubClient's buffer; STRING values only point at it
+    DecentIoTValue v = DecentIoTValue::fromPayload(payload, length);
+    DECENTIOT_STAT(uint32_t handlerStart = micros());
+    handler->callback(v);
+    DECENTIOT_STAT(_stats.handlerTime.record(micros() - handlerStart));
+#if !DECENTIOT_NETWORK_TASK
+    (void)device;
+#endif
 }
 
-void DecentIoTClass::run()
+DecentIoTValue DecentIoTValue::fromPayload(const uint8_t *payload, unsigned int length)
 {
-    unsigned long currentMillis = millis();
-    bool wifiCurrentlyConnected = (WiFi.status() == WL_CONNECTED);
-    
-    // 1. If WiFi is down, can't do anything
-    if (!wifiCurrentlyConnected)
+    DecentIoTValue v;
+    v.stringData = reinterpret_cast<const char *>(payload);
+    v.stringLength = length;
+
+    if (v._stringEquals("true") || v._stringEquals("false"))
     {
-        if (_wasWiFiConnected)
+        v.type = BOOL;
+        v.boolValue = (length == 4);
+        return v;
+    }
+
+    // Accept -?[0-9]*(.[0-9]*)?([eE][+-]?[0-9]+)? with at least one mantissa digit
+    unsigned int i = 0;
+    bool negative = false;
+    if (length > 0 && payload[0] == '-')
+    {
+        negative = true;
+        i = 1;
+    }
+    double mantissa = 0.0;
+    int fractionDigits = 0;
+    bool seenDot = false;
+    bool seenDigit = false;
+    for (; i < length; i++)
+    {
+        uint8_t c = payload[i];
+        if (c >= '0' && c <= '9')
         {
-            _wasWiFiConnected = false;
-            _pubsub.disconnect();
+            mantissa = mantissa * 10.0 + (c - '0');
+            if (seenDot)
+                fractionDigits++;
+            seenDigit = true;
+        }
+        else if (c == '.' && !seenDot)
+        {
+            seenDot = true;
+        }
+        else
+        {
+            break;
         }
-        return;
     }
-    
-    // 2. WiFi is connected - check if we need to handle reconnection
-    if (!_wasWiFiConnected)
+    if (!seenDigit)
+        return v;
+
+    int exponent = 0;
+    bool seenExponent = false;
+    if (i < length && (payload[i] == 'e' || payload[i] == 'E'))
     {
-        // WiFi just came back online - force MQTT reconnection
-        Serial.println("[DecentIoT] WiFi reconnected, attempting MQTT reconnection...");
-        _wasWiFiConnected = true;
-        _lastReconnectAttempt = 0;
-        
-        delay(2000); // Wait for network stability
-        
-        if (reconnectMQTT())
+        i++;
+        bool negativeExponent = false;
+        if (i < length && (payload[i] == '+' || payload[i] == '-'))
+            negativeExponent = payload[i++] == '-';
+        for (; i < length && payload[i] >= '0' && payload[i] <= '9'; i++)
         {
-            Serial.println("[DecentIoT] MQTT reconnected successfully");
-            _subscribeAllPubSub();
-            _publishDeviceStatus(true);
+            seenExponent = true;
+            if (exponent < 1000)
+                exponent = exponent * 10 + (payload[i] - '0');
         }
-        return;
+        if (!seenExponent)
+            return v; // STRING
+        if (negativeExponent)
+            exponent = -exponent;
     }
-    
-    // 3. WiFi is up and was up before - check MQTT connection
-    if (!_pubsub.connected())
+    if (i != length)
+        return v; // STRING
+
+    // With up to 15 digits and |scale| <= 22 the double is correctly rounded;
+    // narrowing it to float can still be one ulp off on rare near-ties. A
+    // zero mantissa stays zero whatever the exponent ("0e999").
+    int scale = exponent - fractionDigits;
+    double number = DecentIoTFormat::scalePow10(mantissa, scale);
+    if (negative)
+        number = -number;
+    if (!seenDot && !seenExponent && number >= INT32_MIN && number <= INT32_MAX)
     {
-        handleReconnection();
-        return;
+        v.type = INT;
+        v.intValue = static_cast<int>(number);
     }
-    
-    // 4. Everything is connected - process MQTT messages
-    _pubsub.loop();
-    
-    // 5. Continue normal operations
-    processScheduledTasks();
-    
-    // 6. Update device status periodically
-    if (currentMillis - _lastStatusUpdate >= _statusUpdateInterval)
+    else
     {
-        _publishDeviceStatus(true);
-        _lastStatusUpdate = currentMillis;
+        v.type = FLOAT;
+        v.floatValue = static_cast<float>(number);
     }
+    return v;
 }
 
-bool DecentIoTClass::connected()
+String DecentIoTValue::toString() const
 {
-    return _pubsub.connected();
+    String s;
+    s.reserve(stringLength);
+    for (size_t i = 0; i < stringLength; i++)
+        s += stringData[i];
+    return s;
 }
-void DecentIoTClass::disconnect()
+
+size_t DecentIoTValue::copyTo(char *buffer, size_t size) const
 {
-    _pubsub.disconnect();
-    _publishDeviceStatus(false);
+    if (size == 0)
+        return 0;
+    size_t n = stringLength < size - 1 ? stringLength : size - 1;
+    if (n > 0)
+        memcpy(buffer, stringData, n);
+    buffer[n] = '\0';
+    return n;
 }
-const char *DecentIoTClass::getStatus()
+
+long DecentIoTValue::_stringToInt() const
 {
-    return _pubsub.connected() ? "connected" : "disconnected";
+    char buffer[32];
+    copyTo(buffer, sizeof(buffer));
+    return atol(buffer);
 }
-const char *DecentIoTClass::getLastError()
+
+float DecentIoTValue::_stringToFloat() const
 {
-    // Return last error string if needed
-    return "";
+    char buffer[32];
+    copyTo(buffer, sizeof(buffer));
+    return static_cast<float>(atof(buffer));
 }
 
-bool DecentIoTClass::isSecure() const
+void DecentIoTClass::write(const char *pin, bool value)
 {
-    return _port == 8883;
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::BOOL, value))
+        return;
+    _policySent(policy, DecentIoTValue::BOOL, value);
+    if (_bufferSample(pin, DecentIoTValue::INT, value ? 1 : 0))
+        return;
+    if (_logValue(pin, DecentIoTValue::BOOL, value ? 1 : 0))
+        return;
+    _publishValue(pin, value ? "true" : "false");
 }
-
-void DecentIoTClass::schedule(uint32_t interval, TaskCallback callback)
+void DecentIoTClass::write(const char *pin, int value)
 {
-    String taskId = "task_" + String(millis());
-    schedule(taskId, interval, callback);
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::INT, value))
+        return;
+    _policySent(policy, DecentIoTValue::INT, value);
+    if (_bufferSample(pin, DecentIoTValue::INT, (uint32_t)value))
+        return;
+    if (_logValue(pin, DecentIoTValue::INT, (uint32_t)value))
+        return;
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatInt(value, buffer, sizeof(buffer));
+    _publishValue(pin, buffer);
 }
-
-void DecentIoTClass::schedule(String taskId, uint32_t interval, TaskCallback callback)
+void DecentIoTClass::write(const char *pin, float value)
+{
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::FLOAT, value))
+        return;
+    _policySent(policy, DecentIoTValue::FLOAT, value);
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (_bufferSample(pin, DecentIoTValue::FLOAT, bits))
+        return;
+    if (_logValue(pin, DecentIoTValue::FLOAT, bits))
+        return;
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    _formatFloat(pin, value, buffer, sizeof(buffer));
+    _publishValue(pin, buffer);
+}
+void DecentIoTClass::write(const char *pin, const char *value)
 {
-    _scheduledTasks[taskId] = {0, interval, callback};
+    _publishValue(pin, value);
 }
 
-void DecentIoTClass::scheduleOnce(uint32_t delay, TaskCallback callback)
+DECENTIOT_ISR_ATTR bool DecentIoTClass::writeFromISR(DecentIoTPin pin, bool value)
 {
-    String taskId = "once_" + String(millis());
-    _scheduledTasks[taskId] = {millis(), delay, callback};
+    return _pushFromISR(pin.id, DecentIoTValue::BOOL, value ? 1 : 0);
 }
-
-void DecentIoTClass::cancel(String taskId)
+DECENTIOT_ISR_ATTR bool DecentIoTClass::writeFromISR(DecentIoTPin pin, int value)
 {
-    _scheduledTasks.erase(taskId);
+    return _pushFromISR(pin.id, DecentIoTValue::INT, (uint32_t)value);
+}
+DECENTIOT_ISR_ATTR bool DecentIoTClass::writeFromISR(DecentIoTPin pin, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return _pushFromISR(pin.id, DecentIoTValue::FLOAT, bits);
 }
 
-void DecentIoTClass::cancelSend(const char *pin)
+DECENTIOT_ISR_ATTR bool DecentIoTClass::_pushFromISR(uint8_t pin, DecentIoTValue::Type type, uint32_t value)
 {
-    // Cancel any scheduled send tasks for this pin
-    String taskId = String("send_") + pin;
-    _scheduledTasks.erase(taskId);
+    IsrRecord record;
+    record.pin = pin;
+    record.type = type;
+    record.value = value;
+    if (pin >= DECENTIOT_PIN_COUNT || !_isrRing.push(record))
+    {
+        _isrDrops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
 }
 
-void DecentIoTClass::processScheduledTasks()
+// Feeds writeFromISR() values into the normal write() path, oldest first
+void DecentIoTClass::_drainISR()
 {
-    unsigned long currentTime = millis();
-    for (auto it = _scheduledTasks.begin(); it != _scheduledTasks.end();)
+    IsrRecord record;
+    uint32_t taken = 0;
+    while (taken++ < DECENTIOT_ISR_RING_SIZE && _isrRing.pop(record))
     {
-        if (currentTime - it->second.lastRun >= it->second.interval)
+        char pin[8];
+        snprintf(pin, sizeof(pin), "P%u", record.pin);
+        if (record.type == DecentIoTValue::BOOL)
         {
-            it->second.callback();
-            it->second.lastRun = currentTime;
-
-            // Remove one-time tasks
-            if (it->first.indexOf("once_") == 0)
-            {
-                it = _scheduledTasks.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
+            write(pin, record.value != 0);
+        }
+        else if (record.type == DecentIoTValue::FLOAT)
+        {
+            float value;
+            memcpy(&value, &record.value, sizeof(value));
+            write(pin, value);
         }
         else
         {
-            ++it;
+            write(pin, (int)record.value);
         }
     }
 }
 
-// Helper function to check if a string is numeric (ESP8266 compatible)
-bool DecentIoTClass::isNumericString(const String &str)
+void DecentIoTClass::setPrecision(const char *pin, int8_t decimals)
 {
-    if (str.length() == 0)
-        return false;
+    int index = _pinIndex(pin, strlen(pin));
+    if (index >= 0)
+        _pinPrecision[index] = decimals < 0 ? -1 : decimals;
+}
 
-    // Check if it's a valid integer (including negative numbers)
-    for (unsigned int i = 0; i < str.length(); i++)
-    {
-        char c = str.charAt(i);
-        if (i == 0 && c == '-')
-            continue; // Allow negative sign at start
-        if (c < '0' || c > '9')
-            return false;
-    }
-    return true;
+void DecentIoTClass::setDeadband(const char *pin, float deadband, DecentIoTDeadbandMode mode)
+{
+    PublishPolicy *policy = _findPolicy(pin, true);
+    if (policy == nullptr)
+        return;
+    policy->deadband = deadband;
+    policy->mode = mode;
 }
 
+void DecentIoTClass::setPublishInterval(const char *pin, uint32_t minInterval, uint32_t maxSilence)
+{
+    PublishPolicy *policy = _findPolicy(pin, true);
+    if (policy == nullptr)
+        return;
+    policy->minInterval = minInterval;
+    policy->maxSilence = maxSilence;
+}
 
-DecentIoTClass::~DecentIoTClass()
+// Policies only exist for P0..P50; nullptr means "publish everything"
+PublishPolicy *DecentIoTClass::_findPolicy(const char *pin, bool create)
 {
-#ifdef ESP8266
-    if (_cert != nullptr)
+    if (_policies.empty() && !create)
+        return nullptr;
+    int index = _pinIndex(pin, strlen(pin));
+    if (index < 0)
     {
-        delete _cert;
-        _cert = nullptr;
+        if (create)
+            Serial.printf("[DecentIoT] Publish policies need a P0-P50 pin, not %s\n", pin);
+        return nullptr;
     }
-#endif
+    if (_policySlot[index] != 0)
+        return &_policies[_policySlot[index] - 1];
+    if (!create)
+        return nullptr;
+    if (_policies.size() >= _policies.max_size() || _policies.size() >= UINT8_MAX)
+    {
+        Serial.printf("[DecentIoT] Cannot add publish policy for %s\n", pin);
+        return nullptr;
+    }
+    PublishPolicy policy;
+    policy.pin = index;
+    _policies.push_back(policy);
+    _policySlot[index] = _policies.size();
+    return &_policies.back();
 }
 
-void DecentIoTClass::_subscribeAllPubSub()
+// False if the policy holds this value back. A changed value that only
+// failed minInterval is kept and sent by run() once the interval is over.
+bool DecentIoTClass::_policyAllows(PublishPolicy *policy, DecentIoTValue::Type type, double value)
 {
-    for (auto &handler : _receiveHandlers) {
-        String topic = _getTopic(handler.id.c_str());
-        _pubsub.subscribe(topic.c_str());
-    }
-}
+    if (policy == nullptr || !policy->hasLast || policy->lastType != type)
+        return true;
+    unsigned long elapsed = millis() - policy->lastPublish;
+    if (policy->maxSilence > 0 && elapsed >= policy->maxSilence)
+        return true;
 
-void DecentIoTClass::_publishDeviceStatus(bool online) {
-    String topic = _projectId + "/users/" + _userId + "/datastreams/" + _deviceId + "/status";
-    
-    // Send just the timestamp - presence indicates online status
-    time_t unixTimestamp = time(nullptr);
-    String payload = String((unsigned long)unixTimestamp);
-    
-    // Use retained message so broker always has latest status
-    if (_pubsub.connected()) {
-        _pubsub.publish(topic.c_str(), payload.c_str(), true); // true = retained
-        // Serial.printf("[STATUS] Device status updated: %lu (%s)\n", 
-        //              (unsigned long)unixTimestamp, ctime(&unixTimestamp));
+    bool changed;
+    if (policy->deadband < 0)
+        changed = true;
+    else if (type == DecentIoTValue::BOOL)
+        changed = value != policy->lastValue;
+    else if (isnan(value) || isnan(policy->lastValue))
+        changed = isnan(value) != isnan(policy->lastValue);
+    else
+    {
+        double threshold = policy->deadband;
+        if (policy->mode == DECENTIOT_DEADBAND_PERCENT)
+            threshold = fabs(policy->lastValue) * policy->deadband / 100.0;
+        changed = fabs(value - policy->lastValue) > threshold;
+    }
+    if (!changed)
+    {
+        policy->hasPending = false;
+        return false;
+    }
+    if (policy->minInterval > 0 && elapsed < policy->minInterval)
+    {
+        policy->hasPending = true;
+        policy->pendingType = type;
+        policy->pendingValue = value;
+        return false;
     }
+    return true;
 }
 
-void DecentIoTClass::handleReconnection()
+void DecentIoTClass::_policySent(PublishPolicy *policy, DecentIoTValue::Type type, double value)
 {
-    unsigned long currentMillis = millis();
-    
-    // Check if WiFi is connected first
-    if (WiFi.status() != WL_CONNECTED)
-    {
+    if (policy == nullptr)
         return;
-    }
-    
-    // Throttle reconnection attempts
-    if (currentMillis - _lastReconnectAttempt < _reconnectInterval)
-    {
+    policy->hasLast = true;
+    policy->hasPending = false;
+    policy->lastType = type;
+    policy->lastValue = value;
+    policy->lastPublish = millis();
+}
+
+void DecentIoTClass::_policyBatched(PublishPolicy *policy, DecentIoTValue::Type type, double value)
+{
+    if (policy == nullptr)
         return;
-    }
-    
-    _lastReconnectAttempt = currentMillis;
-    
-    // Try to reconnect (silent unless it succeeds or fails badly)
-    if (reconnectMQTT())
+    policy->hasBatched = true;
+    policy->batchedType = type;
+    policy->batchedValue = value;
+}
+
+// Called once commitBatch() knows whether the batch went out
+void DecentIoTClass::_settleBatchedPolicies(bool sent)
+{
+    for (size_t i = 0; i < _policies.size(); i++)
     {
-        Serial.println("[DecentIoT] MQTT reconnected");
-        _subscribeAllPubSub();
-        _publishDeviceStatus(true);
+        PublishPolicy &policy = _policies[i];
+        if (!policy.hasBatched)
+            continue;
+        policy.hasBatched = false;
+        if (sent)
+            _policySent(&policy, policy.batchedType, policy.batchedValue);
     }
 }
 
-bool DecentIoTClass::reconnectMQTT()
+// Sends held-back values and maxSilence refreshes that no write() triggered
+void DecentIoTClass::_processPolicies(unsigned long now)
 {
-    // Clean disconnect and stop client
-    _pubsub.disconnect();
-    _client.stop();
-    delay(1000);
-    
-    // Verify time is synchronized (critical for SSL/TLS)
-    time_t now = time(nullptr);
-    if (now < 24 * 3600)
+    for (size_t i = 0; i < _policies.size(); i++)
     {
-        configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-        int retry = 0;
-        while (now < 24 * 3600 && retry < 15)
+        PublishPolicy &policy = _policies[i];
+        if (!policy.hasLast)
+            continue;
+        unsigned long elapsed = now - policy.lastPublish;
+        DecentIoTValue::Type type;
+        double value;
+        if (policy.hasPending && elapsed >= policy.minInterval)
         {
-            delay(500);
-            now = time(nullptr);
-            retry++;
+            type = policy.pendingType;
+            value = policy.pendingValue;
         }
-        if (now < 24 * 3600)
+        else if (policy.maxSilence > 0 && elapsed >= policy.maxSilence)
         {
-            Serial.println("[DecentIoT] WARNING: Time sync failed");
+            type = policy.lastType;
+            value = policy.lastValue;
         }
-    }
-    
-    // Reinitialize SSL/TLS
-#ifdef ESP8266
+        else
+        {
+            continue;
+        }
+
+        char pin[8];
+        snprintf(pin, sizeof(pin), "P%u", policy.pin);
+        if (type == DecentIoTValue::BOOL)
+            write(pin, value != 0);
+        else if (type == DecentIoTValue::FLOAT)
+            write(pin, (float)value);
+        else
+            write(pin, (int)value);
+    }
+}
+
+bool DecentIoTClass::setSampleBuffer(const char *pin, uint16_t maxSamples, uint32_t maxAge)
+{
+    // Blocks are published straight from write(), so only on the task owning MQTT
+    if (_offNetworkTask())
+        return false;
+    int index = _pinIndex(pin, strlen(pin));
+    if (index < 0)
+    {
+        Serial.printf("[DecentIoT] Sample buffers need a P0-P50 pin, not %s\n", pin);
+        return false;
+    }
+    if (_sampleSlot[index] == 0)
+    {
+        if (maxSamples == 0)
+            return true;
+        if (_sampleBuffers.size() >= _sampleBuffers.max_size() || _sampleBuffers.size() >= UINT8_MAX)
+        {
+            Serial.printf("[DecentIoT] Cannot add sample buffer for %s\n", pin);
+            return false;
+        }
+        SampleBuffer buffer;
+        buffer.pin = index;
+        _sampleBuffers.push_back(buffer);
+        _sampleSlot[index] = _sampleBuffers.size();
+    }
+    SampleBuffer &buffer = _sampleBuffers[_sampleSlot[index] - 1];
+    _flushSamples(buffer);
+    buffer.maxSamples = maxSamples;
+    buffer.maxAge = maxAge;
+    return true;
+}
+
+bool DecentIoTClass::flushSamples(const char *pin)
+{
+    int index = _pinIndex(pin, strlen(pin));
+    if (_offNetworkTask() || index < 0 || _sampleSlot[index] == 0)
+        return false;
+    return _flushSamples(_sampleBuffers[_sampleSlot[index] - 1]);
+}
+
+// Numeric writes to a pin with a sample buffer become samples of its block
+bool DecentIoTClass::_bufferSample(const char *pin, DecentIoTValue::Type type, uint32_t value)
+{
+    if (_sampleBuffers.empty() || _offNetworkTask())
+        return false;
+    int index = _pinIndex(pin, strlen(pin));
+    if (index < 0 || _sampleSlot[index] == 0)
+        return false;
+    SampleBuffer &buffer = _sampleBuffers[_sampleSlot[index] - 1];
+    if (buffer.maxSamples == 0)
+        return false;
+
+    uint32_t now = millis();
+    float floatValue;
+    memcpy(&floatValue, &value, sizeof(floatValue));
+    bool added = type == DecentIoTValue::FLOAT ? buffer.block.add(now, floatValue) : buffer.block.add(now, (int32_t)value);
+    if (!added)
+    {
+        // Block full, or the pin switched between int and float
+        _flushSamples(buffer);
+        if (type == DecentIoTValue::FLOAT)
+            buffer.block.add(now, floatValue);
+        else
+            buffer.block.add(now, (int32_t)value);
+    }
+    if (buffer.block.count() >= buffer.maxSamples)
+        _flushSamples(buffer);
+    return true;
+}
+
+// Publishes the block and starts a new one. Blocks are not queued: one that
+// cannot go out (offline, or full while offline) is dropped and counted.
+bool DecentIoTClass::_flushSamples(SampleBuffer &buffer)
+{
+    uint16_t samples = buffer.block.count();
+    if (samples == 0)
+        return true;
+    uint64_t base = _epochMillis(buffer.block.firstMillis());
+    bool epoch = base != 0;
+    size_t length;
+    const uint8_t *data = buffer.block.finish(epoch ? base : buffer.block.firstMillis(), epoch, length);
+
+    char suffix[sizeof("P255/block")];
+    snprintf(suffix, sizeof(suffix), "P%u/block", buffer.pin);
+    const char *topic = _suffixTopic(_topicBuf, _topicPrefixLen, suffix);
+    bool sent = topic != nullptr && _canPublish() && _pubsub.publish(topic, data, length, false);
+    if (sent)
+    {
+        DECENTIOT_STAT(_stats.pins[buffer.pin].publishes++);
+        DECENTIOT_STAT(_stats.pins[buffer.pin].bytesSent += length);
+    }
+    else
+    {
+        DECENTIOT_STAT(_stats.pins[buffer.pin].drops += samples);
+        _queueDrops += samples;
+    }
+    buffer.block.reset();
+    return sent;
+}
+
+void DecentIoTClass::_processSamples(unsigned long now)
+{
+    if (_offNetworkTask())
+        return;
+    for (size_t i = 0; i < _sampleBuffers.size(); i++)
+    {
+        SampleBuffer &buffer = _sampleBuffers[i];
+        if (buffer.maxAge > 0 && buffer.block.count() > 0 && (uint32_t)now - buffer.block.firstMillis() >= buffer.maxAge)
+            _flushSamples(buffer);
+    }
+}
+
+size_t DecentIoTClass::_formatFloat(const char *pin, float value, char *buffer, size_t size) const
+{
+    int index = _pinIndex(pin, strlen(pin));
+    int8_t decimals = index >= 0 ? _pinPrecision[index] : -1;
+    return DecentIoTFormat::formatFloat(value, decimals, buffer, size);
+}
+
+void DecentIoTClass::_publishValue(const char *pin, const char *payload, uint8_t device)
+{
+#if DECENTIOT_NETWORK_TASK
+    if (_offNetworkTask())
+    {
+        _pushOutbound(pin, payload, device);
+        return;
+    }
+#endif
+    // Anything already queued goes first, so a newer value is never
+    // overwritten on the broker by an older retained one
+    if (_queueCount == 0 && _canPublish())
+    {
+        const char *topic = _topicFor(device, pin);
+        if (topic != nullptr && _publishRetained(topic, payload, pin, device))
+        {
+            DECENTIOT_STAT(_pinStats(pin).publishes++);
+            DECENTIOT_STAT(_pinStats(pin).bytesSent += strlen(payload));
+            return;
+        }
+    }
+    _enqueue(pin, payload, device);
+}
+
+// Streamed values are never queued: there is nowhere to keep them. Refused
+// while older values are waiting, which would land on top of this one.
+bool DecentIoTClass::beginPublish(const char *pin, size_t length)
+{
+    if (_offNetworkTask() || _queueCount > 0 || !_canPublish())
+        return false;
+    const char *topic = _getTopic(pin);
+    if (topic == nullptr || !_pubsub.beginPublish(topic, length, true))
+        return false;
+    _streaming = true;
+    _streamLeft = length;
+    DECENTIOT_STAT(_pinStats(pin).publishes++);
+    DECENTIOT_STAT(_pinStats(pin).bytesSent += length);
+    return true;
+}
+
+size_t DecentIoTClass::append(const uint8_t *data, size_t size)
+{
+    if (!_streaming)
+        return 0;
+    if (size > _streamLeft)
+        size = _streamLeft;
+    size_t written = _pubsub.write(data, size);
+    _streamLeft -= written;
+    return written;
+}
+
+size_t DecentIoTClass::append(const char *text)
+{
+    return append(reinterpret_cast<const uint8_t *>(text), strlen(text));
+}
+
+bool DecentIoTClass::endPublish()
+{
+    if (!_streaming)
+        return false;
+    _streaming = false;
+    if (_streamLeft > 0)
+    {
+        // The broker would take whatever comes next as the rest of the payload
+        Serial.printf("[DecentIoT] Streamed publish ended %u bytes short\n", (unsigned)_streamLeft);
+        _streamLeft = 0;
+        _closeSocket();
+        return false;
+    }
+    return _pubsub.endPublish() == 1;
+}
+
+// Offline writes to FIFO pins go to the flash log when one is attached
+bool DecentIoTClass::_logValue(const char *pin, DecentIoTValue::Type type, uint32_t value)
+{
+    // The log belongs to the network task when it runs, see _networkPublish()
+    if (_offNetworkTask() || !_offlineLog.attached() || !_isFifoPin(pin))
+        return false;
+    int index = _pinIndex(pin, strlen(pin));
+    if (index < 0)
+        return false;
+    if (_offlineLog.size() == 0 && _canPublish())
+        return false;
+    return _offlineLog.append(index, type, _epochNow(), value);
+}
+
+// Publishes the oldest logged record; false if there was none or it failed
+bool DecentIoTClass::_replayLogged()
+{
+    DecentIoTLogRecord record;
+    if (!_offlineLog.peek(record))
+        return false;
+
+    // A reading from hours ago would look current on a plain value topic, so
+    // stale records are dropped. Untimed records (clock not set when logged)
+    // and replays before the clock is back cannot be judged and go out.
+    uint32_t now = _epochNow();
+    while (_offlineMaxAge > 0 && record.timestamp != 0 && now > record.timestamp &&
+           now - record.timestamp > _offlineMaxAge)
+    {
+        _queueDrops++;
+        _offlineLog.pop();
+        if (!_offlineLog.peek(record))
+            return false;
+    }
+
+    char pin[8];
+    char payload[DECENTIOT_NUMBER_BUFFER];
+    snprintf(pin, sizeof(pin), "P%u", record.pin);
+    switch (record.type)
+    {
+    case DecentIoTValue::BOOL:
+        strcpy(payload, record.value ? "true" : "false");
+        break;
+    case DecentIoTValue::FLOAT:
+    {
+        float value;
+        memcpy(&value, &record.value, sizeof(value));
+        _formatFloat(pin, value, payload, sizeof(payload));
+        break;
+    }
+    default:
+        DecentIoTFormat::formatInt((int32_t)record.value, payload, sizeof(payload));
+        break;
+    }
+
+    const char *topic = _getTopic(pin);
+    if (topic != nullptr && !_publishRetained(topic, payload, pin, 0))
+        return false;
+    DECENTIOT_STAT(_pinStats(pin).publishes++);
+    DECENTIOT_STAT(_pinStats(pin).bytesSent += strlen(payload));
+    _offlineLog.pop();
+    return true;
+}
+
+bool DecentIoTClass::_canPublish()
+{
+    return _connState == CONN_CONNECTED && !_streaming && _pubsub.connected();
+}
+
+void DecentIoTClass::_enqueue(const char *pin, const char *payload, uint8_t device)
+{
+    size_t pinLen = strlen(pin);
+    size_t payloadLen = strlen(payload);
+    if (pinLen > DECENTIOT_MAX_PIN_NAME || payloadLen > DECENTIOT_MAX_QUEUED_PAYLOAD)
+    {
+        DECENTIOT_STAT(_pinStats(pin).drops++);
+        _queueDrops++;
+        return;
+    }
+
+    if (!_isFifoPin(pin))
+    {
+        // Coalesce: overwrite the pending value for this pin in place
+        for (uint16_t i = 0; i < _queueCount; i++)
+        {
+            QueuedMessage &msg = _queue[(_queueHead + i) % DECENTIOT_QUEUE_SIZE];
+            if (msg.device == device && strcmp(msg.pin, pin) == 0)
+            {
+                memcpy(msg.payload, payload, payloadLen + 1);
+                return;
+            }
+        }
+    }
+
+    if (_queueCount == DECENTIOT_QUEUE_SIZE)
+    {
+        // Full: drop the oldest entry to make room for fresher data
+        DECENTIOT_STAT(_pinStats(_queue[_queueHead].pin).drops++);
+        _queueHead = (_queueHead + 1) % DECENTIOT_QUEUE_SIZE;
+        _queueCount--;
+        _queueDrops++;
+    }
+    QueuedMessage &msg = _queue[(_queueHead + _queueCount) % DECENTIOT_QUEUE_SIZE];
+    msg.device = device;
+    memcpy(msg.pin, pin, pinLen + 1);
+    memcpy(msg.payload, payload, payloadLen + 1);
+    _queueCount++;
+}
+
+void DecentIoTClass::_drainQueue(unsigned long currentMillis)
+{
+    while ((_queueCount > 0 || _offlineLog.size() > 0) && !_budgetExpired())
+    {
+        if (_drainRate > 0)
+        {
+            // Spread the backlog out so a reconnect doesn't trip broker rate limits
+            if (currentMillis - _lastDrain < 1000UL / _drainRate)
+                return;
+            _lastDrain = currentMillis;
+        }
+
+        // The flash log holds the older history, replay it first
+        if (_offlineLog.size() > 0)
+        {
+            if (!_replayLogged() && _offlineLog.size() > 0)
+                return;
+            if (_drainRate > 0)
+                return;
+            continue;
+        }
+
+        QueuedMessage &msg = _queue[_queueHead];
+        const char *topic = _topicFor(msg.device, msg.pin);
+        if (topic != nullptr && !_publishRetained(topic, msg.payload, msg.pin, msg.device))
+            return; // keep it and retry on the next run()
+        DECENTIOT_STAT(_pinStats(msg.pin).publishes++);
+        DECENTIOT_STAT(_pinStats(msg.pin).bytesSent += strlen(msg.payload));
+        _queueHead = (_queueHead + 1) % DECENTIOT_QUEUE_SIZE;
+        _queueCount--;
+
+        if (_drainRate > 0)
+            return; // one message per drain slot
+    }
+}
+
+bool DecentIoTClass::_isFifoPin(const char *pin) const
+{
+    int index = _pinIndex(pin, strlen(pin));
+    return (_fifoPins >> (index >= 0 ? index : 63)) & 1;
+}
+
+void DecentIoTClass::setQueueMode(DecentIoTQueueMode mode)
+{
+    _fifoPins = (mode == DECENTIOT_QUEUE_FIFO) ? ~0ULL : 0;
+}
+
+void DecentIoTClass::setQueueMode(const char *pin, DecentIoTQueueMode mode)
+{
+    int index = _pinIndex(pin, strlen(pin));
+    uint64_t bit = 1ULL << (index >= 0 ? index : 63);
+    if (mode == DECENTIOT_QUEUE_FIFO)
+        _fifoPins |= bit;
+    else
+        _fifoPins &= ~bit;
+}
+
+void DecentIoTClass::setQueueDrainRate(uint16_t messagesPerSecond)
+{
+    _drainRate = messagesPerSecond;
+}
+
+bool DecentIoTClass::setOfflineStorage(DecentIoTLogStorage *storage)
+{
+    return _offlineLog.begin(storage);
+}
+
+void DecentIoTClass::setOfflineMaxAge(uint32_t seconds)
+{
+    _offlineMaxAge = seconds;
+}
+
+uint32_t DecentIoTClass::getOfflineLogSize() const
+{
+    return _offlineLog.size();
+}
+
+size_t DecentIoTClass::getQueueDepth() const
+{
+    return _queueCount;
+}
+
+uint32_t DecentIoTClass::getQueueDrops() const
+{
+#if DECENTIOT_NETWORK_TASK
+    return _queueDrops + _isrDrops.load() + _ringDrops.load();
+#else
+    return _queueDrops + _isrDrops.load();
+#endif
+}
+
+void DecentIoTClass::beginBatch()
+{
+    _batching = true;
+    _batchLen = 0;
+}
+
+// Numeric add()s follow the pin's publish policy; write() checks it again
+// on fallback, which gives the same answer since nothing was sent yet. The
+// policy only records the value once commitBatch() has published it.
+void DecentIoTClass::add(const char *pin, bool value)
+{
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::BOOL, value))
+        return;
+    if (_batchAdd(pin, value ? "true" : "false", false))
+        _policyBatched(policy, DecentIoTValue::BOOL, value);
+    else
+        write(pin, value);
+}
+void DecentIoTClass::add(const char *pin, int value)
+{
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::INT, value))
+        return;
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatInt(value, buffer, sizeof(buffer));
+    if (_batchAdd(pin, buffer, false))
+        _policyBatched(policy, DecentIoTValue::INT, value);
+    else
+        write(pin, value);
+}
+void DecentIoTClass::add(const char *pin, float value)
+{
+    PublishPolicy *policy = _findPolicy(pin);
+    if (!_policyAllows(policy, DecentIoTValue::FLOAT, value))
+        return;
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    _formatFloat(pin, value, buffer, sizeof(buffer));
+    // JSON has no nan/inf; send those through write() as plain text
+    if (isfinite(value) && _batchAdd(pin, buffer, false))
+        _policyBatched(policy, DecentIoTValue::FLOAT, value);
+    else
+        write(pin, value);
+}
+void DecentIoTClass::add(const char *pin, const char *value)
+{
+    if (!_batchAdd(pin, value, true))
+        write(pin, value);
+}
+
+bool DecentIoTClass::commitBatch()
+{
+    _batching = false;
+    if (_batchLen == 0)
+        return true;
+    _batchBuf[_batchLen++] = '}';
+    _batchBuf[_batchLen] = '\0';
+    _batchLen = 0;
+
+    const char *topic = _getDeviceTopic("batch");
+    if (topic == nullptr || !_canPublish() || !_pubsub.publish(topic, _batchBuf, true))
+    {
+        Serial.println("⚠️  MQTT batch publish failed");
+        _settleBatchedPolicies(false);
+        _requeueBatch();
+        return false;
+    }
+    _settleBatchedPolicies(true);
+    DECENTIOT_STAT(_stats.batches++);
+    DECENTIOT_STAT(_stats.batchBytes += strlen(_batchBuf));
+    return true;
+}
+
+// Appends "pin":value to the open batch. Returns false if the value should
+// go through write() instead (no batch open, offline, or too large).
+bool DecentIoTClass::_batchAdd(const char *pin, const char *value, bool quoted)
+{
+    // Batches don't fit the network task's rings; values go through write().
+    // So do values that would overtake older ones still in the offline queue.
+    if (!_batching || _offNetworkTask() || !_canPublish() || _queueCount > 0)
+        return false;
+
+    size_t valueLen = 0;
+    for (const char *c = value; *c; c++)
+    {
+        if (!quoted)
+            valueLen++;
+        else if (*c == '"' || *c == '\\')
+            valueLen += 2;
+        else if ((uint8_t)*c < 0x20)
+            valueLen += 6; // \u00XX
+        else
+            valueLen++;
+    }
+    // ,"pin":value plus room for the closing brace and terminator
+    size_t needed = 1 + strlen(pin) + 3 + valueLen + (quoted ? 2 : 0) + 2;
+    if (needed + 1 > DECENTIOT_BATCH_SIZE)
+        return false;
+    if (_batchLen + needed > DECENTIOT_BATCH_SIZE)
+    {
+        // Full: send what we have and keep going in a fresh batch
+        commitBatch();
+        _batching = true;
+    }
+
+    char *out = _batchBuf + _batchLen;
+    *out++ = _batchLen == 0 ? '{' : ',';
+    *out++ = '"';
+    for (const char *c = pin; *c; c++)
+        *out++ = *c;
+    *out++ = '"';
+    *out++ = ':';
+    if (quoted)
+        *out++ = '"';
+    for (const char *c = value; *c; c++)
+    {
+        if (quoted && (*c == '"' || *c == '\\'))
+        {
+            *out++ = '\\';
+            *out++ = *c;
+        }
+        else if (quoted && (uint8_t)*c < 0x20)
+        {
+            out += sprintf(out, "\\u%04x", (uint8_t)*c);
+        }
+        else
+        {
+            *out++ = *c;
+        }
+    }
+    if (quoted)
+        *out++ = '"';
+    _batchLen = out - _batchBuf;
+    return true;
+}
+
+// A batch that could not be published goes back through the offline queue
+// one value at a time, in order, so it is delayed instead of lost
+void DecentIoTClass::_requeueBatch()
+{
+    const char *p = _batchBuf + 1;
+    while (*p == '"')
+    {
+        const char *pinEnd = strchr(p + 1, '"');
+        size_t pinLen = pinEnd - (p + 1);
+        char pin[DECENTIOT_MAX_PIN_NAME + 1];
+        bool fits = pinLen <= DECENTIOT_MAX_PIN_NAME;
+        if (fits)
+        {
+            memcpy(pin, p + 1, pinLen);
+            pin[pinLen] = '\0';
+        }
+
+        // Undo the escaping _batchAdd() applied to string values
+        char value[DECENTIOT_MAX_QUEUED_PAYLOAD + 1];
+        size_t n = 0;
+        p = pinEnd + 2; // past '":'
+        if (*p == '"')
+        {
+            for (p++; *p != '"'; p++)
+            {
+                char c = *p;
+                if (c == '\\')
+                {
+                    c = *++p;
+                    if (c == 'u')
+                    {
+                        char hex[3] = {p[3], p[4], '\0'};
+                        c = (char)strtol(hex, nullptr, 16);
+                        p += 4;
+                    }
+                }
+                if (n < DECENTIOT_MAX_QUEUED_PAYLOAD)
+                    value[n++] = c;
+                else
+                    fits = false;
+            }
+            p++;
+        }
+        else
+        {
+            for (; *p != ',' && *p != '}'; p++)
+            {
+                if (n < DECENTIOT_MAX_QUEUED_PAYLOAD)
+                    value[n++] = *p;
+                else
+                    fits = false;
+            }
+        }
+        value[n] = '\0';
+
+        if (fits)
+            _enqueue(pin, value);
+        else
+            _queueDrops++;
+        if (*p == ',')
+            p++;
+    }
+}
+
+// Demultiplexes a flat JSON object of pin values into the receive handlers.
+// Each value is decoded exactly like a single-pin payload.
+void DecentIoTClass::_handleBatch(const uint8_t *payload, unsigned int length)
+{
+    const char *p = reinterpret_cast<const char *>(payload);
+    const char *end = p + length;
+    auto skipSpace = [&]() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+            p++;
+    };
+
+    skipSpace();
+    if (p == end || *p++ != '{')
+        return;
+    while (true)
+    {
+        skipSpace();
+        if (p == end || *p != '"')
+            return; // also covers "}"
+        const char *pin = ++p;
+        while (p < end && *p != '"')
+            p++;
+        if (p == end)
+            return;
+        size_t pinLen = p++ - pin;
+        skipSpace();
+        if (p == end || *p++ != ':')
+            return;
+        skipSpace();
+
+        const char *value = p;
+        size_t valueLen;
+        char unescaped[DECENTIOT_MAX_QUEUED_PAYLOAD + 1];
+        if (p < end && *p == '"')
+        {
+            // String: point at it in place unless it needs unescaping
+            value = ++p;
+            size_t n = 0;
+            bool escaped = false;
+            while (p < end && *p != '"')
+            {
+                char c = *p++;
+                if (c == '\\' && p < end)
+                {
+                    escaped = true;
+                    c = *p++;
+                    if (c == 'n') c = '\n';
+                    else if (c == 't') c = '\t';
+                    else if (c == 'r') c = '\r';
+                    else if (c == 'b') c = '\b';
+                    else if (c == 'f') c = '\f';
+                    else if (c == 'u')
+                    {
+                        if (end - p < 4)
+                            return;
+                        char hex[5] = {p[0], p[1], p[2], p[3], 0};
+                        long code = strtol(hex, nullptr, 16);
+                        c = code < 0x80 ? (char)code : '?';
+                        p += 4;
+                    }
+                }
+                if (n < sizeof(unescaped) - 1)
+                    unescaped[n++] = c;
+            }
+            if (p == end)
+                return;
+            valueLen = p - value;
+            p++;
+            if (escaped)
+            {
+                value = unescaped;
+                valueLen = n;
+            }
+        }
+        else
+        {
+            while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\r' && *p != '\n' && *p != '\t')
+                p++;
+            valueLen = p - value;
+        }
+
+        ReceiveHandler *handler = _findReceiveHandler(_receiveHandlers, _receiveSlot, pin, pinLen);
+        if (handler != nullptr && !(valueLen == 4 && memcmp(value, "null", 4) == 0))
+        {
+            _deliver(handler, reinterpret_cast<const uint8_t *>(value), valueLen);
+        }
+
+        skipSpace();
+        if (p == end || *p != ',')
+            return;
+        p++;
+    }
+}
+
+void DecentIoTClass::publishStatus(const char *status)
+{
+    _publishStatus(status, 0);
+}
+
+void DecentIoTClass::_publishStatus(const char *status, uint8_t device)
+{
+#if DECENTIOT_NETWORK_TASK
+    if (_offNetworkTask())
+    {
+        _pushOutbound("", status, device);
+        return;
+    }
+#endif
+    const char *topic;
+    if (device == 0)
+        topic = _getDeviceTopic("status");
+    else if (device <= _devices.size())
+        topic = _suffixTopic(_devices[device - 1]->_topicBuf, _devices[device - 1]->_topicPrefixLen, "status");
+    else
+        return;
+    if (topic == nullptr)
+        return;
+    if (_canPublish())
+    {
+        _pubsub.publish(topic, status, true);
+    }
+    else
+    {
+        Serial.println("⚠️  MQTT not connected, skipping status");
+    }
+}
+
+void DecentIoTClass::run(uint32_t budgetMicros)
+{
+    _runStart = micros();
+    _runBudget = budgetMicros;
+    unsigned long currentMillis = millis();
+
+#if DECENTIOT_NETWORK_TASK
+    // MQTT lives on the network task; here only hand over what it received
+    if (_networkThread.running())
+        _deliverInbound();
+    else
+#endif
+        _runNetwork(currentMillis);
+
+    _drainISR();
+    if (_connState == CONN_CONNECTED)
+    {
+        _processPolicies(currentMillis);
+        _processSamples(currentMillis);
+    }
+
+    // Scheduled tasks keep running while offline or reconnecting
+    processScheduledTasks();
+    DECENTIOT_STAT(_stats.runTime.record(micros() - _runStart));
+}
+
+// Connection, inbound messages, offline backlog and heartbeats: everything
+// that touches the socket, on whichever task owns it
+void DecentIoTClass::_runNetwork(unsigned long currentMillis)
+{
+    if (_streaming)
+        return; // the socket belongs to the open beginPublish() until endPublish()
+    _updateClock(currentMillis);
+    bool wifiCurrentlyConnected = (WiFi.status() == WL_CONNECTED);
+    
+    // 1. Connection management - never blocks, at most one step per call
+    if (!wifiCurrentlyConnected)
+    {
+        if (_wasWiFiConnected)
+        {
+            _wasWiFiConnected = false;
+            _pubsub.disconnect();
+        }
+        DECENTIOT_STAT(_sessionLost());
+        _connState = CONN_IDLE;
+    }
+    else if (!_wasWiFiConnected)
+    {
+        // WiFi is up, for the first time or again: connect right away. Only
+        // retries after a failed attempt wait, see _scheduleReconnect().
+        Serial.println("[DecentIoT] WiFi connected, connecting to MQTT...");
+        _wasWiFiConnected = true;
+        _lastReconnectAttempt = currentMillis;
+        _reconnectAttempts = 0;
+        _closeSocket(); // the session went with the old link
+        _timeSyncRequested = false; // the sync window starts now, not at begin()
+        _connState = CONN_TIME_SYNC;
+        _connectionWait(0);
+    }
+    else if (_connState != CONN_CONNECTED || !_pubsub.connected())
+    {
+        handleReconnection();
+    }
+    else
+    {
+        // 2. Everything is connected - process MQTT messages first, they
+        //    carry control commands, then send anything written while offline
+        uint32_t reads = 0;
+        uint32_t before;
+        do
+        {
+            before = _messagesRead;
+            _pubsub.loop();
+        } while (_messagesRead != before && ++reads < DECENTIOT_MAX_MESSAGES_PER_RUN && !_budgetExpired());
+        _drainQueue(currentMillis);
+    }
+    
+    // 3. Update device status periodically
+    if (_connState == CONN_CONNECTED && currentMillis - _lastStatusUpdate >= _statusUpdateInterval)
+    {
+        _publishDeviceStatus(true);
+        _lastStatusUpdate = currentMillis;
+    }
+    if (_connState == CONN_CONNECTED)
+        _processHeartbeats(currentMillis);
+
+#if DECENTIOT_METRICS
+    if (_metricsInterval > 0 && _connState == CONN_CONNECTED && currentMillis - _lastMetrics >= _metricsInterval)
+    {
+        _publishMetrics();
+        _lastMetrics = currentMillis;
+    }
+#endif
+}
+
+// From the sketch side of the network task the client (and its TLS context)
+// belongs to the other task, so only the published state is read
+bool DecentIoTClass::connected()
+{
+    if (_offNetworkTask())
+        return _connState == CONN_CONNECTED;
+    return _pubsub.connected();
+}
+void DecentIoTClass::disconnect()
+{
+#if DECENTIOT_NETWORK_TASK
+    if (_offNetworkTask())
+    {
+        _disconnectRequested = true;
+        return;
+    }
+#endif
+    _pubsub.disconnect();
+    _publishDeviceStatus(false);
+}
+const char *DecentIoTClass::getStatus()
+{
+    if (_offNetworkTask() ? _connState == CONN_CONNECTED : _pubsub.connected())
+        return "connected";
+    return _connState == CONN_IDLE ? "disconnected" : "connecting";
+}
+const char *DecentIoTClass::getLastError()
+{
+    return _lastError;
+}
+
+bool DecentIoTClass::isSecure() const
+{
+    return _port == 8883;
+}
+
+uint32_t DecentIoTClass::getEpochTime() const
+{
+    return _epochNow();
+}
+
+// Polls the system clock (kept by SNTP in the background) every 100 ms until
+// it is valid, then once per resync interval. Reads in between are millis().
+void DecentIoTClass::_updateClock(unsigned long currentMillis)
+{
+    unsigned long interval = _clockEpoch == 0 ? 100 : _clockResyncInterval;
+    if (_clockChecked && currentMillis - _clockLastCheck < interval)
+        return;
+    _clockChecked = true;
+    _clockLastCheck = currentMillis;
+    time_t now = time(nullptr);
+    if (now < 24 * 3600)
+        return;
+    if (_clockEpoch == 0)
+        Serial.printf("[DecentIoT] Time synced after %lu ms\n", (unsigned long)(currentMillis - _timeSyncStart));
+    _clockEpoch = (uint32_t)now;
+    _clockMillis = currentMillis;
+}
+
+uint32_t DecentIoTClass::_epochNow() const
+{
+    if (_clockEpoch == 0)
+        return 0;
+    return _clockEpoch + (uint32_t)(millis() - _clockMillis) / 1000;
+}
+
+// Epoch milliseconds at the millis() reading `at`, 0 until the clock is set
+uint64_t DecentIoTClass::_epochMillis(uint32_t at) const
+{
+    if (_clockEpoch == 0)
+        return 0;
+    return (uint64_t)_clockEpoch * 1000 + (int32_t)(at - (uint32_t)_clockMillis);
+}
+
+bool DecentIoTClass::_offNetworkTask() const
+{
+#if DECENTIOT_NETWORK_TASK
+    return _networkThread.running() && !_networkThread.isCurrent();
+#else
+    return false;
+#endif
+}
+
+#if DECENTIOT_NETWORK_TASK
+bool DecentIoTClass::startNetworkTask(int core, uint32_t stackSize)
+{
+    // From here on write() cannot publish blocks; send what is buffered
+    for (size_t i = 0; i < _sampleBuffers.size(); i++)
+        _flushSamples(_sampleBuffers[i]);
+    _networkStop = false;
+    if (!_networkThread.start(_networkTaskEntry, this, "DecentIoT", stackSize, core))
+    {
+        Serial.println("[DecentIoT] Could not start the network task");
+        return false;
+    }
+    return true;
+}
+
+void DecentIoTClass::stopNetworkTask()
+{
+    if (!_networkThread.running())
+        return;
+    _networkStop = true;
+    _networkThread.join();
+    // Back to inline mode: flush whatever the sketch wrote in the meantime
+    QueuedMessage msg;
+    while (_outbound.pop(msg))
+        _networkPublish(msg);
+    _deliverInbound();
+}
+
+void DecentIoTClass::_networkTaskEntry(void *self)
+{
+    static_cast<DecentIoTClass *>(self)->_networkLoop();
+}
+
+void DecentIoTClass::_networkLoop()
+{
+    while (!_networkStop)
+    {
+        if (_disconnectRequested.exchange(false))
+            disconnect();
+
+        QueuedMessage msg;
+        uint32_t taken = 0;
+        while (taken < DECENTIOT_RING_SIZE && _outbound.pop(msg))
+        {
+            _networkPublish(msg);
+            taken++;
+        }
+
+        _runNetwork(millis());
+        if (taken == 0)
+            DecentIoTThread::sleep(1);
+    }
+}
+
+// A write() from the sketch, now on the network task. Numeric values for
+// FIFO pins go to the flash log while offline, as they would inline.
+void DecentIoTClass::_networkPublish(const QueuedMessage &msg)
+{
+    if (msg.pin[0] == '\0')
+    {
+        _publishStatus(msg.payload, msg.device);
+        return;
+    }
+    if (msg.device == 0 && _offlineLog.attached())
+    {
+        DecentIoTValue v = DecentIoTValue::fromPayload(reinterpret_cast<const uint8_t *>(msg.payload), strlen(msg.payload));
+        uint32_t bits = 0;
+        if (v.type == DecentIoTValue::BOOL)
+            bits = v.boolValue;
+        else if (v.type == DecentIoTValue::INT)
+            bits = (uint32_t)v.intValue;
+        else if (v.type == DecentIoTValue::FLOAT)
+            memcpy(&bits, &v.floatValue, sizeof(bits));
+        if (v.type != DecentIoTValue::STRING && _logValue(msg.pin, v.type, bits))
+            return;
+    }
+    _publishValue(msg.pin, msg.payload, msg.device);
+}
+
+void DecentIoTClass::_pushOutbound(const char *pin, const char *payload, uint8_t device)
+{
+    QueuedMessage msg;
+    size_t pinLen = strlen(pin);
+    size_t payloadLen = strlen(payload);
+    if (pinLen > DECENTIOT_MAX_PIN_NAME || payloadLen > DECENTIOT_MAX_QUEUED_PAYLOAD)
+    {
+        _ringDrops++;
+        return;
+    }
+    msg.device = device;
+    memcpy(msg.pin, pin, pinLen + 1);
+    memcpy(msg.payload, payload, payloadLen + 1);
+    if (!_outbound.push(msg))
+        _ringDrops++;
+}
+
+// Runs receive handlers for values the network task picked up
+void DecentIoTClass::_deliverInbound()
+{
+    InboundMessage msg;
+    uint32_t delivered = 0;
+    while (delivered < DECENTIOT_MAX_MESSAGES_PER_RUN && !_budgetExpired() && _inbound.pop(msg))
+    {
+        ReceiveHandlerList &handlers = msg.device == 0 ? _receiveHandlers : _devices[msg.device - 1]->_receiveHandlers;
+        if (msg.handler < handlers.size())
+        {
+            DecentIoTValue v = DecentIoTValue::fromPayload(reinterpret_cast<const uint8_t *>(msg.payload), msg.length);
+            DECENTIOT_STAT(uint32_t handlerStart = micros());
+            handlers[msg.handler].callback(v);
+            DECENTIOT_STAT(_stats.handlerTime.record(micros() - handlerStart));
+        }
+        delivered++;
+    }
+}
+#endif
+
+#if DECENTIOT_METRICS
+void DecentIoTClass::resetStats()
+{
+    _stats = DecentIoTStats();
+}
+
+void DecentIoTClass::setMetricsInterval(uint32_t interval)
+{
+    _metricsInterval = interval;
+    _lastMetrics = millis();
+}
+
+DecentIoTPinStats &DecentIoTClass::_pinStats(const char *pin)
+{
+    int index = _pinIndex(pin, strlen(pin));
+    return _stats.pins[index >= 0 ? index : DECENTIOT_PIN_COUNT];
+}
+
+// Starts the reconnect timer the first time a live session is seen to be gone
+void DecentIoTClass::_sessionLost()
+{
+    if (_connState == CONN_CONNECTED)
+        _sessionLostAt = millis();
+}
+
+// Device-wide totals as one small JSON object, not retained
+void DecentIoTClass::_publishMetrics()
+{
+    DecentIoTPinStats total;
+    for (const DecentIoTPinStats &pin : _stats.pins)
+    {
+        total.publishes += pin.publishes;
+        total.drops += pin.drops;
+        total.received += pin.received;
+        total.bytesSent += pin.bytesSent;
+        total.bytesReceived += pin.bytesReceived;
+    }
+
+    char payload[416]; // stays below the 512-byte PubSubClient buffer with the topic
+    snprintf(payload, sizeof(payload),
+             "{\"pub\":%lu,\"drop\":%lu,\"rx\":%lu,\"tx_bytes\":%lu,\"rx_bytes\":%lu,\"batches\":%lu,"
+             "\"runs\":%lu,\"run_p50\":%lu,\"run_p99\":%lu,\"run_max\":%lu,"
+             "\"handler_p99\":%lu,\"handler_max\":%lu,\"late_p99\":%lu,\"late_max\":%lu,"
+             "\"reconnects\":%lu,\"reconnect_max\":%lu,\"tls_p50\":%lu,\"tls_max\":%lu}",
+             (unsigned long)total.publishes, (unsigned long)total.drops, (unsigned long)total.received,
+             (unsigned long)(total.bytesSent + _stats.batchBytes), (unsigned long)total.bytesReceived,
+             (unsigned long)_stats.batches, (unsigned long)_stats.runTime.count,
+             (unsigned long)_stats.runTime.percentile(50), (unsigned long)_stats.runTime.percentile(99),
+             (unsigned long)_stats.runTime.max, (unsigned long)_stats.handlerTime.percentile(99),
+             (unsigned long)_stats.handlerTime.max, (unsigned long)_stats.taskLateness.percentile(99),
+             (unsigned long)_stats.taskLateness.max, (unsigned long)_stats.reconnects,
+             (unsigned long)_stats.reconnectTime.max, (unsigned long)_stats.tlsHandshake.percentile(50),
+             (unsigned long)_stats.tlsHandshake.max);
+
+    const char *topic = _getDeviceTopic("metrics");
+    if (topic != nullptr)
+        _pubsub.publish(topic, payload, false);
+}
+#endif
+
+DecentIoTTaskId DecentIoTClass::schedule(uint32_t interval, TaskCallback callback)
+{
+    // Like the old lastRun = 0 behaviour: first run once `interval` ms of uptime have passed
+    return _addTask(interval, interval, false, callback);
+}
+
+DecentIoTTaskId DecentIoTClass::schedule(const char *taskId, uint32_t interval, TaskCallback callback)
+{
+    if (strlen(taskId) > DECENTIOT_MAX_TASK_NAME)
+    {
+        Serial.printf("[DecentIoT] Task name too long: %s\n", taskId);
+        return 0;
+    }
+    
+    // Re-scheduling under an existing name replaces that task
+    cancel(taskId);
+    if (_taskNames.size() >= _taskNames.max_size())
+    {
+        Serial.println("[DecentIoT] Too many named tasks");
+        return 0;
+    }
+    
+    DecentIoTTaskId handle = schedule(interval, callback);
+    if (handle != 0)
+    {
+        ScheduledTaskName entry;
+        strcpy(entry.name, taskId);
+        entry.id = handle;
+        _taskNames.push_back(entry);
+    }
+    return handle;
+}
+
+DecentIoTTaskId DecentIoTClass::schedule(const String &taskId, uint32_t interval, TaskCallback callback)
+{
+    return schedule(taskId.c_str(), interval, callback);
+}
+
+DecentIoTTaskId DecentIoTClass::scheduleOnce(uint32_t delay, TaskCallback callback)
+{
+    return _addTask(_schedulerNow() + delay, delay, true, callback);
+}
+
+void DecentIoTClass::cancel(const char *taskId)
+{
+    int index = _findTaskName(taskId);
+    if (index >= 0)
+        cancel(_taskNames[index].id);
+}
+
+void DecentIoTClass::cancel(const String &taskId)
+{
+    cancel(taskId.c_str());
+}
+
+void DecentIoTClass::cancel(DecentIoTTaskId handle)
+{
+    ScheduledTask *task = _findTask(handle);
+    if (task == nullptr)
+        return;
+    if (task->heapPos != SIZE_MAX)
+    {
+        _heapRemove(task->heapPos);
+    }
+    _freeTask(handle & 0xFFFF);
+    
+    for (size_t i = 0; i < _taskNames.size(); i++)
+    {
+        if (_taskNames[i].id == handle)
+        {
+            // Unordered removal: move the last name into this spot
+            _taskNames[i] = _taskNames.back();
+            _taskNames.pop_back();
+            break;
+        }
+    }
+}
+
+void DecentIoTClass::cancelSend(const char *pin)
+{
+    // Cancel any scheduled send tasks for this pin
+    char taskId[DECENTIOT_MAX_TASK_NAME + 1];
+    snprintf(taskId, sizeof(taskId), "send_%s", pin);
+    cancel(taskId);
+}
+
+void DecentIoTClass::setPriority(DecentIoTTaskId handle, DecentIoTPriority priority)
+{
+    ScheduledTask *task = _findTask(handle);
+    if (task != nullptr)
+        task->priority = priority;
+}
+
+void DecentIoTClass::setPriority(const char *taskOrPin, DecentIoTPriority priority)
+{
+    setPriority(_findTaskHandle(taskOrPin), priority);
+}
+
+DecentIoTTaskJitter DecentIoTClass::getTaskJitter(DecentIoTTaskId handle) const
+{
+    DecentIoTTaskJitter jitter = {0, 0, 0, 0};
+    uint16_t slot = handle & 0xFFFF;
+    if (handle == 0 || slot >= _tasks.size() || _tasks[slot].id != handle)
+        return jitter;
+    const ScheduledTask &task = _tasks[slot];
+    jitter.runs = task.runs;
+    jitter.last = task.lastLateness;
+    jitter.max = task.maxLateness;
+    jitter.mean = task.runs == 0 ? 0 : (uint32_t)(task.totalLateness / task.runs);
+    return jitter;
+}
+
+DecentIoTTaskJitter DecentIoTClass::getTaskJitter(const char *taskOrPin) const
+{
+    return getTaskJitter(_findTaskHandle(taskOrPin));
+}
+
+// A task name, or a pin whose DECENTIOT_SEND task is meant ("P1" -> "send_P1")
+DecentIoTTaskId DecentIoTClass::_findTaskHandle(const char *taskOrPin) const
+{
+    int index = _findTaskName(taskOrPin);
+    if (index < 0)
+    {
+        char sendId[DECENTIOT_MAX_TASK_NAME + 1];
+        snprintf(sendId, sizeof(sendId), "send_%s", taskOrPin);
+        index = _findTaskName(sendId);
+    }
+    return index >= 0 ? _taskNames[index].id : 0;
+}
+
+bool DecentIoTClass::_budgetExpired() const
+{
+#if DECENTIOT_NETWORK_TASK
+    if (_networkThread.isCurrent())
+        return false; // the budget belongs to the sketch's run() call
+#endif
+    return _runBudget != 0 && micros() - _runStart >= _runBudget;
+}
+
+void DecentIoTClass::processScheduledTasks()
+{
+    uint64_t now = _schedulerNow();
+    if (_taskHeap.empty() || _tasks[_taskHeap[0]].deadline > now)
+        return;
+
+    // Take every due task off the heap (in deadline order), then stable-sort
+    // by priority. Each runs at most once per call, even with a 0 ms interval.
+    _dueTasks.clear();
+    while (!_taskHeap.empty() && _tasks[_taskHeap[0]].deadline <= now)
+    {
+        _dueTasks.push_back(_tasks[_taskHeap[0]].id);
+        _heapRemove(0);
+    }
+    for (size_t i = 1; i < _dueTasks.size(); i++)
+    {
+        DecentIoTTaskId id = _dueTasks[i];
+        DecentIoTPriority priority = _tasks[id & 0xFFFF].priority;
+        size_t j = i;
+        for (; j > 0 && _tasks[_dueTasks[j - 1] & 0xFFFF].priority < priority; j--)
+            _dueTasks[j] = _dueTasks[j - 1];
+        _dueTasks[j] = id;
+    }
+
+    for (size_t i = 0; i < _dueTasks.size(); i++)
+    {
+        DecentIoTTaskId id = _dueTasks[i];
+        uint16_t slot = id & 0xFFFF;
+        if (_tasks[slot].id != id)
+            continue; // cancelled by an earlier task in this round
+
+        // Out of time: the rest go back on the heap with their deadlines
+        // intact and run first next time. The first task always runs, so
+        // the highest-priority work makes progress even on a tight budget.
+        if (i > 0 && _budgetExpired())
+        {
+            _heapPush(slot);
+            continue;
+        }
+
+        ScheduledTask &due = _tasks[slot];
+        uint32_t lateness = (uint32_t)(now - due.deadline);
+        DECENTIOT_STAT(_stats.taskLateness.record(lateness));
+        due.runs++;
+        due.lastLateness = lateness;
+        due.totalLateness += lateness;
+        if (lateness > due.maxLateness)
+            due.maxLateness = lateness;
+
+        // Move the callback out: it may schedule or cancel tasks, which can
+        // reallocate _tasks or free this slot while it runs
+        bool once = due.once;
+        TaskCallback callback = std::move(_tasks[slot].callback);
+        if (once)
+        {
+            _freeTask(slot);
+        }
+
+        DECENTIOT_STAT(uint32_t handlerStart = micros());
+        callback();
+        DECENTIOT_STAT(_stats.handlerTime.record(micros() - handlerStart));
+
+        if (once || _tasks[slot].id != id)
+            continue; // one-shot, or cancelled from inside its own callback
+
+        ScheduledTask &task = _tasks[slot];
+        task.callback = std::move(callback);
+        task.deadline = now + task.interval;
+        _heapPush(slot);
+    }
+}
+
+DecentIoTTaskId DecentIoTClass::_addTask(uint64_t deadline, uint32_t interval, bool once, TaskCallback callback)
+{
+    uint16_t slot;
+    if (!_freeTaskSlots.empty())
+    {
+        slot = _freeTaskSlots.back();
+        _freeTaskSlots.pop_back();
+    }
+    else if (_tasks.size() < _tasks.max_size() && _tasks.size() < 0xFFFF)
+    {
+        slot = _tasks.size();
+        _tasks.push_back(ScheduledTask());
+    }
+    else
+    {
+        Serial.println("[DecentIoT] Too many scheduled tasks");
+        return 0;
+    }
+
+    ScheduledTask &task = _tasks[slot];
+    // Bump the generation so handles to a previous occupant stay invalid
+    uint16_t generation = (task.id >> 16) + 1;
+    if (generation == 0)
+        generation = 1;
+    task.id = ((DecentIoTTaskId)generation << 16) | slot;
+    task.deadline = deadline;
+    task.interval = interval;
+    task.once = once;
+    task.callback = callback;
+    task.priority = DECENTIOT_PRIORITY_NORMAL;
+    task.runs = 0;
+    task.lastLateness = 0;
+    task.maxLateness = 0;
+    task.totalLateness = 0;
+    _heapPush(slot);
+    return task.id;
+}
+
+int DecentIoTClass::_findTaskName(const char *taskId) const
+{
+    for (size_t i = 0; i < _taskNames.size(); i++)
+    {
+        if (strcmp(_taskNames[i].name, taskId) == 0)
+            return i;
+    }
+    return -1;
+}
+
+ScheduledTask *DecentIoTClass::_findTask(DecentIoTTaskId handle)
+{
+    uint16_t slot = handle & 0xFFFF;
+    if (handle == 0 || slot >= _tasks.size() || _tasks[slot].id != handle)
+        return nullptr;
+    return &_tasks[slot];
+}
+
+void DecentIoTClass::_freeTask(uint16_t slot)
+{
+    ScheduledTask &task = _tasks[slot];
+    // Advance the generation and clear the slot bits so the old handle (and,
+    // for slot 0, the plain generation value) never matches again
+    task.id = (task.id & 0xFFFF0000) + 0x10000;
+    task.heapPos = SIZE_MAX;
+    task.callback = nullptr;
+    _freeTaskSlots.push_back(slot);
+}
+
+// millis() wraps every ~49 days; extend it to 64 bits so deadlines never wrap
+uint64_t DecentIoTClass::_schedulerNow()
+{
+    uint32_t current = millis();
+    _schedulerClock += (uint32_t)(current - _schedulerLastMillis);
+    _schedulerLastMillis = current;
+    return _schedulerClock;
+}
+
+bool DecentIoTClass::_taskBefore(uint16_t a, uint16_t b) const
+{
+    return _tasks[a].deadline < _tasks[b].deadline;
+}
+
+void DecentIoTClass::_heapPush(uint16_t slot)
+{
+    _tasks[slot].heapPos = _taskHeap.size();
+    _taskHeap.push_back(slot);
+    _heapSiftUp(_taskHeap.size() - 1);
+}
+
+void DecentIoTClass::_heapRemove(size_t pos)
+{
+    _tasks[_taskHeap[pos]].heapPos = SIZE_MAX;
+    uint16_t last = _taskHeap.back();
+    _taskHeap.pop_back();
+    if (pos == _taskHeap.size())
+        return;
+    _taskHeap[pos] = last;
+    _tasks[last].heapPos = pos;
+    _heapSiftUp(pos);
+    _heapSiftDown(_tasks[last].heapPos);
+}
+
+void DecentIoTClass::_heapSiftUp(size_t pos)
+{
+    while (pos > 0)
+    {
+        size_t parent = (pos - 1) / 2;
+        if (!_taskBefore(_taskHeap[pos], _taskHeap[parent]))
+            break;
+        std::swap(_taskHeap[pos], _taskHeap[parent]);
+        _tasks[_taskHeap[pos]].heapPos = pos;
+        _tasks[_taskHeap[parent]].heapPos = parent;
+        pos = parent;
+    }
+}
+
+void DecentIoTClass::_heapSiftDown(size_t pos)
+{
+    size_t size = _taskHeap.size();
+    while (true)
+    {
+        size_t smallest = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < size && _taskBefore(_taskHeap[left], _taskHeap[smallest]))
+            smallest = left;
+        if (right < size && _taskBefore(_taskHeap[right], _taskHeap[smallest]))
+            smallest = right;
+        if (smallest == pos)
+            break;
+        std::swap(_taskHeap[pos], _taskHeap[smallest]);
+        _tasks[_taskHeap[pos]].heapPos = pos;
+        _tasks[_taskHeap[smallest]].heapPos = smallest;
+        pos = smallest;
+    }
+}
+
+DecentIoTClass::~DecentIoTClass()
+{
+#if DECENTIOT_NETWORK_TASK
+    stopNetworkTask();
+#endif
+    delete[] _topicBuf;
+    _topicBuf = nullptr;
+#ifdef ESP8266
     if (_cert != nullptr)
     {
-        _client.setTrustAnchors(_cert);
+        delete _cert;
+        _cert = nullptr;
+    }
+#endif
+}
+
+void DecentIoTClass::setSubscribeMode(DecentIoTSubscribeMode mode)
+{
+    _subscribeMode = mode;
+}
+
+void DecentIoTClass::_subscribeAllPubSub()
+{
+    // Only the devices registered here, never the user's whole datastream tree
+    for (auto device : _devices)
+        _subscribeDevice(*device);
+
+    if (_receiveHandlers.empty() && _streamHandlers.empty())
+        return;
+    
+    if (_subscribeMode == DECENTIOT_SUBSCRIBE_WILDCARD) {
+        // One round trip no matter how many pins; _handleMessage drops pins
+        // without a handler, including echoes of our own writes
+        const char *topic = _getTopic("+");
+        if (topic != nullptr)
+            _pubsub.subscribe(topic);
+    } else {
+        for (auto &handler : _receiveHandlers) {
+            const char *topic = _getTopic(handler.id);
+            if (topic != nullptr)
+                _pubsub.subscribe(topic);
+        }
+        // Stream-only pins; one that also has onReceive() is subscribed above
+        for (auto &handler : _streamHandlers) {
+            if (_findReceiveHandler(_receiveHandlers, _receiveSlot, handler.id, strlen(handler.id)) != nullptr)
+                continue;
+            const char *topic = _getTopic(handler.id);
+            if (topic != nullptr)
+                _pubsub.subscribe(topic);
+        }
+    }
+    
+    // Batches are split into receive handler calls, never streamed
+    if (_receiveHandlers.empty())
+        return;
+    const char *batchTopic = _getDeviceTopic("batch/set");
+    if (batchTopic != nullptr)
+        _pubsub.subscribe(batchTopic);
+}
+
+void DecentIoTClass::_publishDeviceStatus(bool online) {
+    const char *topic = _getDeviceTopic("status");
+    if (topic == nullptr)
+        return;
+    
+    // Send just the timestamp - presence indicates online status
+    uint32_t unixTimestamp = _epochNow();
+    char payload[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatUint(unixTimestamp, payload, sizeof(payload));
+    
+    // Use retained message so broker always has latest status. Not in the
+    // middle of a beginPublish(), whose payload the broker is still reading.
+    if (_canPublish()) {
+        _pubsub.publish(topic, payload, true); // true = retained
+        // Serial.printf("[STATUS] Device status updated: %lu (%s)\n", 
+        //              (unsigned long)unixTimestamp, ctime(&unixTimestamp));
+    }
+}
+
+bool DecentIoTClass::addDevice(DecentIoTDevice &device)
+{
+    size_t idLen = strlen(device._id);
+    bool running = false;
+#if DECENTIOT_NETWORK_TASK
+    running = _networkThread.running();
+#endif
+    if (idLen == 0 || device._gateway != nullptr || running || _devices.size() >= _devices.max_size() ||
+        _findDevice(device._id, idLen) != nullptr || _deviceId == device._id)
+    {
+        Serial.printf("[DecentIoT] Cannot add device %s\n", device._id);
+        return false;
+    }
+    _devices.push_back(&device);
+    device._gateway = this;
+    device._index = _devices.size();
+
+    uint32_t mask = _deviceTableSize - 1;
+    uint32_t pos = _hashDeviceId(device._id, idLen) & mask;
+    while (_deviceTable[pos] != 0)
+        pos = (pos + 1) & mask;
+    _deviceTable[pos] = device._index;
+
+    if (_topicBuf != nullptr)
+        _buildDeviceTopic(device);
+    if (_canPublish())
+        _subscribeDevice(device);
+    return true;
+}
+
+DecentIoTDevice *DecentIoTClass::getDevice(const char *deviceId)
+{
+    return _findDevice(deviceId, strlen(deviceId));
+}
+
+// FNV-1a
+uint32_t DecentIoTClass::_hashDeviceId(const char *id, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= (uint8_t)id[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Linear probing; the table is at most half full, so a lookup is a hash and
+// typically one comparison however many devices the gateway fronts
+DecentIoTDevice *DecentIoTClass::_findDevice(const char *id, size_t len)
+{
+    if (_devices.empty())
+        return nullptr;
+    uint32_t mask = _deviceTableSize - 1;
+    for (uint32_t pos = _hashDeviceId(id, len) & mask; _deviceTable[pos] != 0; pos = (pos + 1) & mask)
+    {
+        DecentIoTDevice *device = _devices[_deviceTable[pos] - 1];
+        if (strlen(device->_id) == len && memcmp(device->_id, id, len) == 0)
+            return device;
+    }
+    return nullptr;
+}
+
+void DecentIoTClass::_buildDeviceTopic(DecentIoTDevice &device)
+{
+    size_t idLen = strlen(device._id);
+    device._topicPrefixLen = _datastreamsLen + idLen + 1;
+    delete[] device._topicBuf;
+    device._topicBuf = new char[device._topicPrefixLen + DECENTIOT_MAX_PIN_NAME + sizeof("/value")];
+    memcpy(device._topicBuf, _topicBuf, _datastreamsLen);
+    memcpy(device._topicBuf + _datastreamsLen, device._id, idLen);
+    device._topicBuf[device._topicPrefixLen - 1] = '/';
+    device._topicBuf[device._topicPrefixLen] = '\0';
+}
+
+void DecentIoTClass::_subscribeDevice(DecentIoTDevice &device)
+{
+    if (device._receiveHandlers.empty())
+        return;
+    if (_subscribeMode == DECENTIOT_SUBSCRIBE_WILDCARD)
+    {
+        const char *topic = _pinTopic(device._topicBuf, device._topicPrefixLen, "+");
+        if (topic != nullptr)
+            _pubsub.subscribe(topic);
+        return;
+    }
+    for (auto &handler : device._receiveHandlers)
+    {
+        const char *topic = _pinTopic(device._topicBuf, device._topicPrefixLen, handler.id);
+        if (topic != nullptr)
+            _pubsub.subscribe(topic);
+    }
+}
+
+// Same payload as _publishDeviceStatus(): the timestamp alone means online
+void DecentIoTClass::_publishHeartbeat(DecentIoTDevice &device, unsigned long currentMillis)
+{
+    const char *topic = _suffixTopic(device._topicBuf, device._topicPrefixLen, "status");
+    if (topic == nullptr)
+        return;
+    char payload[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatUint(_epochNow(), payload, sizeof(payload));
+    if (_pubsub.publish(topic, payload, true))
+    {
+        device._heartbeatDue = false;
+        device._lastHeartbeat = currentMillis;
+    }
+}
+
+void DecentIoTClass::_processHeartbeats(unsigned long currentMillis)
+{
+    for (auto device : _devices)
+    {
+        if (!device->_online || _budgetExpired())
+            continue;
+        if (device->_heartbeatDue ||
+            (device->_heartbeatInterval > 0 && currentMillis - device->_lastHeartbeat >= device->_heartbeatInterval))
+        {
+            _publishHeartbeat(*device, currentMillis);
+        }
+    }
+}
+
+void DecentIoTClass::handleReconnection()
+{
+    unsigned long currentMillis = millis();
+    
+    // Check if WiFi is connected first
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        return;
+    }
+    
+    if (_connState == CONN_CONNECTED)
+    {
+        // Connection was lost since the last run()
+        DECENTIOT_STAT(_sessionLost());
+        _connState = CONN_IDLE;
+        _scheduleReconnect(currentMillis);
+    }
+    
+    if (_connState == CONN_IDLE)
+    {
+        // Throttle reconnection attempts
+        if (currentMillis - _lastReconnectAttempt < _reconnectDelay)
+        {
+            return;
+        }
+        _lastReconnectAttempt = currentMillis;
+        _startConnection(0);
+    }
+    
+    if (_advanceConnection())
+    {
+        Serial.println("[DecentIoT] MQTT reconnected");
+    }
+}
+
+void DecentIoTClass::setReconnectBackoff(uint32_t minDelay, uint32_t maxDelay)
+{
+    _backoffBase = minDelay > 0 ? minDelay : 1;
+    _backoffMax = maxDelay > _backoffBase ? maxDelay : _backoffBase;
+}
+
+// Exponential backoff with full jitter: the next attempt comes after a random
+// delay in [0, min(max, base * 2^attempts)], so a fleet that lost the broker
+// together spreads its reconnects out instead of retrying in lockstep
+void DecentIoTClass::_scheduleReconnect(unsigned long currentMillis)
+{
+    uint8_t steps = _reconnectAttempts;
+    switch (_pubsub.state())
+    {
+    case MQTT_CONNECT_BAD_PROTOCOL:
+    case MQTT_CONNECT_BAD_CLIENT_ID:
+    case MQTT_CONNECT_BAD_CREDENTIALS:
+    case MQTT_CONNECT_UNAUTHORIZED:
+        steps = 31; // rejected: retrying soon will not help
+        break;
+    case MQTT_CONNECT_UNAVAILABLE:
+        steps++; // broker is shedding load, back off faster
+        break;
+    default:
+        break;
+    }
+
+    uint32_t ceiling = _backoffBase;
+    for (uint8_t i = 0; i < steps && ceiling < _backoffMax; i++)
+    {
+        ceiling = ceiling > _backoffMax / 2 ? _backoffMax : ceiling * 2;
+    }
+    if (ceiling > _backoffMax)
+        ceiling = _backoffMax;
+
+    _reconnectDelay = (uint32_t)random((long)ceiling) + 1;
+    if (_reconnectAttempts < 31)
+        _reconnectAttempts++;
+    _lastReconnectAttempt = currentMillis;
+}
+
+void DecentIoTClass::_startConnection(unsigned long settleMs)
+{
+    _connState = CONN_DISCONNECTING;
+    _connectionWait(settleMs);
+}
+
+void DecentIoTClass::_connectionWait(unsigned long ms)
+{
+    _connWaitStart = millis();
+    _connWaitMs = ms;
+}
+
+// Runs one step of the connection sequence; returns true once the session is ready
+bool DecentIoTClass::_advanceConnection()
+{
+    unsigned long currentMillis = millis();
+    if (currentMillis - _connWaitStart < _connWaitMs)
+    {
+        return false;
+    }
+    
+    switch (_connState)
+    {
+    case CONN_DISCONNECTING:
+        // Clean disconnect and stop client
+        _pubsub.disconnect();
+        _closeSocket();
+        _timeSyncRequested = false;
+        _connState = CONN_TIME_SYNC;
+        _connectionWait(1000); // let the old socket close
+        return false;
+    
+    case CONN_TIME_SYNC:
+    {
+        // Verify time is synchronized (critical for SSL/TLS)
+        _updateClock(currentMillis);
+        if (_clockEpoch != 0)
+        {
+            _connState = CONN_TLS_HANDSHAKE;
+            return false;
+        }
+        if (!_timeSyncRequested)
+        {
+            configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+            _timeSyncRequested = true;
+            _timeSyncStart = currentMillis;
+        }
+        else if (currentMillis - _timeSyncStart >= _timeSyncTimeout)
+        {
+            Serial.println("[DecentIoT] WARNING: Time sync failed");
+            _lastError = "time sync failed";
+            _connState = CONN_TLS_HANDSHAKE;
+            return false;
+        }
+        _connectionWait(100);
+        return false;
+    }
+    
+    case CONN_TLS_HANDSHAKE:
+    {
+        _configureClient();
+        DECENTIOT_STAT(uint32_t handshakeStart = millis());
+        bool tlsConnected = _openSocket();
+        DECENTIOT_STAT(_stats.tlsHandshake.record(millis() - handshakeStart));
+        if (!tlsConnected)
+        {
+            Serial.println("[DecentIoT] TLS connection failed");
+            _lastError = "TLS connection failed";
+            _connState = CONN_IDLE;
+            _scheduleReconnect(currentMillis);
+            return false;
+        }
+        _connState = CONN_MQTT_CONNECT;
+        return false;
+    }
+    
+    case CONN_MQTT_CONNECT:
+    {
+        // The socket is already open, so the client only sends CONNECT here
+        char clientId[20];
+        _makeClientId(clientId, sizeof(clientId));
+        if (!_pubsub.connect(clientId, _username.c_str(), _password.c_str()))
+        {
+            Serial.printf("[DecentIoT] MQTT connect failed, state: %d\n", _pubsub.state());
+            _lastError = "MQTT connect failed";
+            _closeSocket();
+            _connState = CONN_IDLE;
+            _scheduleReconnect(currentMillis);
+            return false;
+        }
+        _connState = CONN_RESUBSCRIBE;
+        return false;
+    }
+    
+    case CONN_RESUBSCRIBE:
+        _subscribeAllPubSub();
+        for (auto device : _devices)
+            device->_heartbeatDue = true;
+#if DECENTIOT_NATIVE_MQTT
+        // Aliases only live as long as the connection
+        memset(_topicAlias, 0, sizeof(_topicAlias));
+        _aliasCount = 0;
+#endif
+        _connState = CONN_CONNECTED;
+        _reconnectAttempts = 0;
+        _publishDeviceStatus(true);
+#if DECENTIOT_METRICS
+        if (_hadSession)
+        {
+            _stats.reconnects++;
+            _stats.reconnectTime.record(millis() - _sessionLostAt);
+        }
+        _hadSession = true;
+#endif
+        return true;
+    
+    default:
+        return false;
+    }
+}
+
+void DecentIoTClass::_makeClientId(char *buffer, size_t size)
+{
+    snprintf(buffer, size, "DecentIoT-%lx", (unsigned long)random(0xffff));
+}
+
+void DecentIoTClass::setCACert(const char *cert)
+{
+    _caCert = cert;
+#ifdef ESP8266
+    // Re-parse on the next _applyTrust(); a session from another trust
+    // setup must not be resumed
+    delete _cert;
+    _cert = nullptr;
+    _tlsSession = BearSSL::Session();
+#endif
+    _applyTrust();
+}
+
+// Trust anchors are parsed once and only handed back to the client on reconnect.
+// Order matters on ESP8266: begin() without a CA puts the client in insecure
+// mode, and setTrustAnchors() is not guaranteed to clear that flag on every
+// core. A CA set after begin() therefore replaces the client (dropping its
+// socket) before the anchors go in, so the next handshake really verifies.
+void DecentIoTClass::_applyTrust()
+{
+#ifdef ESP8266
+    if (_cert == nullptr)
+    {
+        _cert = new BearSSL::X509List(_caCert != nullptr ? _caCert : root_ca);
+    }
+    if (_caCert != nullptr && _insecure)
+    {
+        _client.stop();
+        _client = WiFiClientSecure();
+        _insecure = false;
     }
-    _client.setInsecure();
+    _client.setTrustAnchors(_cert);
+    if (_caCert == nullptr)
+    {
+        _client.setInsecure(); // built-in CA keeps the old unverified default
+        _insecure = true;
+    }
+    _client.setSession(&_tlsSession);
 #elif defined(ESP32)
-    _client.setCACert(root_ca);
+    // WiFiClientSecure keeps only the pointer; mbedTLS parses it per handshake
+    // and the Arduino core exposes no session cache to resume from
+    _client.setCACert(_caCert != nullptr ? _caCert : root_ca);
 #endif
+}
+
+void DecentIoTClass::_configureClient()
+{
+    _applyTrust();
     
-    // Reinitialize PubSubClient
+    // Reinitialize the MQTT client
     _pubsub.setClient(_client);
     _pubsub.setBufferSize(512);
     _pubsub.setServer(_broker.c_str(), _port);
     _pubsub.setCallback([this](char* topic, byte* payload, unsigned int length) {
         _handleMessage(topic, payload, length);
     });
-    
-    // Try to connect
-    String clientId = "DecentIoT-" + String(random(0xffff), HEX);
-    return _pubsub.connect(clientId.c_str(), _username.c_str(), _password.c_str());
-}
\ No newline at end of file
+#if DECENTIOT_NATIVE_MQTT
+    _pubsub.setStreamCallback([this](char *topic, const uint8_t *data, size_t length, size_t offset, size_t total) {
+        _handleStream(topic, data, length, offset, total);
+    });
+#endif
+}
+
+// Pin values are retained. With the native client a P0..P50 pin of this
+// device goes out under its topic alias once the broker knows it.
+bool DecentIoTClass::_publishRetained(const char *topic, const char *payload, const char *pin, uint8_t device)
+{
+#if DECENTIOT_NATIVE_MQTT
+    uint16_t alias = device == 0 ? _aliasFor(pin) : 0;
+    return _pubsub.publish(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload), true,
+                           _pubsub.getPublishQos(), alias);
+#else
+    (void)pin;
+    (void)device;
+    return _pubsub.publish(topic, payload, true);
+#endif
+}
+
+#if DECENTIOT_NATIVE_MQTT
+uint16_t DecentIoTClass::_aliasFor(const char *pin)
+{
+    int index = _pinIndex(pin, strlen(pin));
+    if (index < 0)
+        return 0;
+    if (_topicAlias[index] == 0 && _aliasCount < _pubsub.topicAliasMax())
+        _topicAlias[index] = ++_aliasCount;
+    return _topicAlias[index];
+}
+#endif
+
+bool DecentIoTClass::_openSocket()
+{
+#if DECENTIOT_NATIVE_MQTT
+    return _pubsub.transport().connect(_broker.c_str(), _port);
+#else
+    return _client.connect(_broker.c_str(), _port);
+#endif
+}
+
+void DecentIoTClass::_closeSocket()
+{
+#if DECENTIOT_NATIVE_MQTT
+    _pubsub.transport().stop();
+#else
+    _client.stop();
+#endif
+}
+
+#if DECENTIOT_NATIVE_MQTT
+void DecentIoTClass::setTransport(DecentIoTTransport &transport)
+{
+    _pubsub.setTransport(transport);
+}
+
+void DecentIoTClass::setPublishQos(uint8_t qos)
+{
+    _pubsub.setPublishQos(qos);
+}
+
+void DecentIoTClass::setProtocolVersion(uint8_t version)
+{
+    _pubsub.setProtocolVersion(version);
+}
+#endif
@@ -19,9 +19,21 @@
 
 #include <Arduino.h>
 #include <vector>
-#include <map>
 #include <functional>
 
+// Heap-free mode: defining either limit (as a build flag) switches handler and
+// task storage to fixed arrays and callbacks to function pointer + context
+#if defined(DECENTIOT_MAX_PINS) || defined(DECENTIOT_MAX_TASKS)
+#define DECENTIOT_STATIC 1
+#endif
+#ifndef DECENTIOT_MAX_PINS
+#define DECENTIOT_MAX_PINS 16
+#endif
+#ifndef DECENTIOT_MAX_TASKS
+#define DECENTIOT_MAX_TASKS 16
+#endif
+#include "DecentIoTStatic.h"
+
 // Platform-specific includes and declarations
 #ifdef ESP8266
 #include <ESP8266WiFi.h>
@@ -34,9 +46,133 @@
 #include <WiFiClientSecure.h>
 #endif
 
+// Native MQTT client: -DDECENTIOT_NATIVE_MQTT=1 replaces PubSubClient with
+// DecentIoTMqtt (streamed publishes, QoS 1, pluggable transport)
+#ifndef DECENTIOT_NATIVE_MQTT
+#define DECENTIOT_NATIVE_MQTT 0
+#endif
+#if DECENTIOT_NATIVE_MQTT
+#include "DecentIoTMqtt.h"
+using DecentIoTMqttClient = DecentIoTMqtt;
+#else
 #include <PubSubClient.h>
+using DecentIoTMqttClient = PubSubClient;
+#endif
+#include "DecentIoTOfflineLog.h"
+#include "DecentIoTFormat.h"
+#include "DecentIoTMetrics.h"
+#include "DecentIoTSeries.h"
+
+// Network task mode: MQTT and TLS run on their own pinned FreeRTOS task and
+// talk to the sketch through lock-free rings. Enable with the build flag
+// -DDECENTIOT_NETWORK_TASK=1 (ESP32, or a host build using std::thread).
+#ifndef DECENTIOT_NETWORK_TASK
+#define DECENTIOT_NETWORK_TASK 0
+#endif
+#include "DecentIoTRing.h"
+#if DECENTIOT_NETWORK_TASK
+#ifdef ESP8266
+#error "DECENTIOT_NETWORK_TASK needs ESP32 or a host build"
+#endif
+#include "DecentIoTThread.h"
+// Entries per ring (power of two) and the largest value handed to a receive handler
+#ifndef DECENTIOT_RING_SIZE
+#define DECENTIOT_RING_SIZE 16
+#endif
+#ifndef DECENTIOT_MAX_INBOUND_PAYLOAD
+#define DECENTIOT_MAX_INBOUND_PAYLOAD 63
+#endif
+#endif
+
+// Virtual pins P0..P50 resolve to handler table indices 0..50
+#define DECENTIOT_PIN_COUNT 51
+// Longest pin name the topic buffer reserves room for (custom names included)
+#define DECENTIOT_MAX_PIN_NAME 15
+// Longest name accepted by schedule(taskId, ...)
+#define DECENTIOT_MAX_TASK_NAME 23
+
+// Outbound queue used while MQTT is disconnected (fixed size, no heap)
+#ifndef DECENTIOT_QUEUE_SIZE
+#define DECENTIOT_QUEUE_SIZE 16
+#endif
+#ifndef DECENTIOT_MAX_QUEUED_PAYLOAD
+#define DECENTIOT_MAX_QUEUED_PAYLOAD 31
+#endif
+
+// Flash log records older than this many seconds are dropped on replay
+// rather than published as current values; 0 replays everything
+#ifndef DECENTIOT_OFFLINE_MAX_AGE
+#define DECENTIOT_OFFLINE_MAX_AGE 86400
+#endif
+
+// Values from writeFromISR() waiting for run() (power of two, 12 bytes each)
+#ifndef DECENTIOT_ISR_RING_SIZE
+#define DECENTIOT_ISR_RING_SIZE 16
+#endif
+
+// Payload buffer for beginBatch()/add()/commitBatch(); keep it below the
+// PubSubClient buffer (512) minus the topic
+#ifndef DECENTIOT_BATCH_SIZE
+#define DECENTIOT_BATCH_SIZE 384
+#endif
+
+// Upper bound on inbound messages read per run(), so a flood of control
+// messages cannot starve scheduled tasks
+#ifndef DECENTIOT_MAX_MESSAGES_PER_RUN
+#define DECENTIOT_MAX_MESSAGES_PER_RUN 8
+#endif
+
+// Gateway mode: logical devices added with addDevice() share one connection
+#ifndef DECENTIOT_MAX_DEVICES
+#define DECENTIOT_MAX_DEVICES 32
+#endif
+#define DECENTIOT_MAX_DEVICE_ID 31
+
+// Pins with a sample buffer (setSampleBuffer()). Each holds one block of
+// DECENTIOT_SERIES_BLOCK_SIZE bytes, which must fit the MQTT buffer too.
+#ifndef DECENTIOT_MAX_SAMPLE_BUFFERS
+#define DECENTIOT_MAX_SAMPLE_BUFFERS 4
+#endif
+
+// How receive pins are subscribed after each (re)connect
+enum DecentIoTSubscribeMode
+{
+    DECENTIOT_SUBSCRIBE_PER_PIN, // one SUBSCRIBE per receive pin (default)
+    DECENTIOT_SUBSCRIBE_WILDCARD // one SUBSCRIBE to "<device>/+/value", filtered locally
+};
 
+// How writes to a pin are held while offline
+enum DecentIoTQueueMode
+{
+    DECENTIOT_QUEUE_LATEST, // keep only the newest value per pin (default)
+    DECENTIOT_QUEUE_FIFO    // keep every value, in order
+};
 
+// How setDeadband() compares a new value with the last published one
+enum DecentIoTDeadbandMode
+{
+    DECENTIOT_DEADBAND_ABSOLUTE, // change must exceed the deadband itself
+    DECENTIOT_DEADBAND_PERCENT   // change must exceed deadband % of the last value
+};
+
+// Order in which tasks that are due at the same time run
+enum DecentIoTPriority : uint8_t
+{
+    DECENTIOT_PRIORITY_LOW,
+    DECENTIOT_PRIORITY_NORMAL, // default
+    DECENTIOT_PRIORITY_HIGH
+};
+
+// Virtual pin with its table index resolved at compile time. Converts to the
+// pin name, so P0..P50 still work anywhere a const char * pin is accepted.
+struct DecentIoTPin
+{
+    uint8_t id;
+    const char *name;
+
+    constexpr DecentIoTPin(uint8_t pinId, const char *pinName) : id(pinId), name(pinName) {}
+    constexpr operator const char *() const { return name; }
+};
 
 struct DecentIoTValue
 {
@@ -46,11 +182,24 @@ struct DecentIoTValue
         INT,
         FLOAT,
         STRING
-    } type;
-    bool boolValue;
-    int intValue;
-    float floatValue;
-    String stringValue;
+    } type = STRING;
+    bool boolValue = false;
+    int intValue = 0;
+    float floatValue = 0.0f;
+    // STRING values are a view into the received MQTT payload. It is not
+    // NUL-terminated and is only valid inside the receive callback; use
+    // toString() or copyTo() to keep it.
+    const char *stringData = nullptr;
+    size_t stringLength = 0;
+
+    // Single pass over the payload: bool, int, float, otherwise string
+    static DecentIoTValue fromPayload(const uint8_t *payload, unsigned int length);
+
+    String toString() const;
+    size_t copyTo(char *buffer, size_t size) const; // NUL-terminates, returns chars copied
+
+    // Was a String member holding the raw payload; now a copy of it, same as toString()
+    __attribute__((deprecated("use toString()"))) String stringValue() const { return toString(); }
 
     // Implicit conversion operators
     operator bool() const
@@ -62,7 +211,7 @@ struct DecentIoTValue
         if (type == FLOAT)
             return floatValue != 0.0f;
         if (type == STRING)
-            return stringValue == "true" || stringValue == "1";
+            return _stringEquals("true") || _stringEquals("1");
         return false;
     }
     operator int() const
@@ -74,7 +223,7 @@ struct DecentIoTValue
         if (type == FLOAT)
             return static_cast<int>(floatValue);
         if (type == STRING)
-            return stringValue.toInt();
+            return static_cast<int>(_stringToInt());
         return 0;
     }
     operator float() const
@@ -86,13 +235,13 @@ struct DecentIoTValue
         if (type == BOOL)
             return boolValue ? 1.0f : 0.0f;
         if (type == STRING)
-            return stringValue.toFloat();
+            return _stringToFloat();
         return 0.0f;
     }
     operator String() const
     {
         if (type == STRING)
-            return stringValue;
+            return toString();
         if (type == BOOL)
             return boolValue ? "true" : "false";
         if (type == INT)
@@ -110,35 +259,230 @@ struct DecentIoTValue
         if (type == FLOAT)
             return static_cast<uint8_t>(floatValue);
         if (type == STRING)
-            return (stringValue == "true" || stringValue == "1") ? HIGH : LOW;
+            return (_stringEquals("true") || _stringEquals("1")) ? HIGH : LOW;
         return 0;
     }
+
+private:
+    bool _stringEquals(const char *text) const
+    {
+        return strlen(text) == stringLength && memcmp(stringData, text, stringLength) == 0;
+    }
+    // Same leading-number semantics as String::toInt()/toFloat()
+    long _stringToInt() const;
+    float _stringToFloat() const;
 };
+// One piece of a payload delivered to an onReceiveStream() handler. Pieces
+// arrive in order; data is only valid during the call.
+struct DecentIoTChunk
+{
+    const uint8_t *data;
+    size_t length;
+    size_t offset; // position of data in the whole payload
+    size_t total;  // whole payload length
+
+    bool first() const { return offset == 0; }
+    bool last() const { return offset + length == total; }
+};
+
+#ifdef DECENTIOT_STATIC
+using ReceiveCallback = DecentIoTStaticCallback<const DecentIoTValue &>;
+using ReceiveStreamCallback = DecentIoTStaticCallback<const DecentIoTChunk &>;
+using SendCallback = DecentIoTStaticCallback<>;
+using TaskCallback = DecentIoTStaticCallback<>;
+template <typename T, size_t N>
+using DecentIoTList = DecentIoTFixedVector<T, N>;
+#else
 using ReceiveCallback = std::function<void(const DecentIoTValue &value)>;
+using ReceiveStreamCallback = std::function<void(const DecentIoTChunk &chunk)>;
 using SendCallback = std::function<void()>;
 using TaskCallback = std::function<void()>;
+template <typename T, size_t N>
+using DecentIoTList = std::vector<T>;
+#endif
 
 struct ReceiveHandler
 {
-    String id;
+    char id[DECENTIOT_MAX_PIN_NAME + 1];
     ReceiveCallback callback;
 };
+using ReceiveHandlerList = DecentIoTList<ReceiveHandler, DECENTIOT_MAX_PINS>;
+struct ReceiveStreamHandler
+{
+    char id[DECENTIOT_MAX_PIN_NAME + 1];
+    ReceiveStreamCallback callback;
+};
 struct SendHandler
 {
-    String id;
+    char id[DECENTIOT_MAX_PIN_NAME + 1];
     SendCallback callback;
 };
 
+// Task handle returned by schedule()/scheduleOnce(): slot index in the low
+// 16 bits, slot generation in the high 16 bits. 0 is never a valid handle.
+using DecentIoTTaskId = uint32_t;
+
+// Outbound message held until the connection is back
+struct QueuedMessage
+{
+    uint8_t device; // 0 = this device, n = gateway device n (see addDevice())
+    char pin[DECENTIOT_MAX_PIN_NAME + 1];
+    char payload[DECENTIOT_MAX_QUEUED_PAYLOAD + 1];
+};
+
+// Fixed-size record written by writeFromISR(), published later by run()
+struct IsrRecord
+{
+    uint8_t pin;  // P0..P50
+    uint8_t type; // DecentIoTValue::Type
+    uint32_t value; // bool/int as is, float as its bit pattern
+};
+
+#if DECENTIOT_NETWORK_TASK
+// Value received on the network task, waiting for run() to call its handler
+struct InboundMessage
+{
+    uint8_t device;  // 0 = this device, n = gateway device n
+    uint8_t handler; // index into that device's _receiveHandlers
+    uint8_t length;
+    char payload[DECENTIOT_MAX_INBOUND_PAYLOAD + 1];
+};
+#endif
+
+// Publish policy for one pin. A numeric write is sent only if it moved more
+// than the deadband and minInterval has passed; maxSilence forces a resend.
+struct PublishPolicy
+{
+    uint8_t pin;
+    DecentIoTDeadbandMode mode = DECENTIOT_DEADBAND_ABSOLUTE;
+    float deadband = -1.0f; // < 0: every value counts as a change
+    uint32_t minInterval = 0;
+    uint32_t maxSilence = 0;
+    bool hasLast = false;
+    bool hasPending = false; // held back by minInterval, sent once it passes
+    bool hasBatched = false; // in the open batch, counts as sent once it goes out
+    DecentIoTValue::Type lastType = DecentIoTValue::INT;
+    DecentIoTValue::Type pendingType = DecentIoTValue::INT;
+    DecentIoTValue::Type batchedType = DecentIoTValue::INT;
+    unsigned long lastPublish = 0;
+    double lastValue = 0;
+    double pendingValue = 0;
+    double batchedValue = 0;
+};
+
+// Numeric writes to one pin, collected into a compressed block
+struct SampleBuffer
+{
+    uint8_t pin;
+    uint16_t maxSamples = 0; // 0 = buffering turned off
+    uint32_t maxAge = 0;     // ms since the first sample, 0 = no limit
+    DecentIoTSeriesEncoder block;
+};
+
+#if DECENTIOT_METRICS
+// Snapshot returned by getStats(). pins[DECENTIOT_PIN_COUNT] collects
+// custom pin names; batched values are counted under batches only.
+struct DecentIoTStats
+{
+    DecentIoTPinStats pins[DECENTIOT_PIN_COUNT + 1];
+    uint32_t batches = 0;
+    uint32_t batchBytes = 0;
+    uint32_t reconnects = 0;
+    DecentIoTHistogram runTime;       // us per run()
+    DecentIoTHistogram handlerTime;   // us per receive handler or scheduled task
+    DecentIoTHistogram reconnectTime; // ms from losing the session to being connected again
+    DecentIoTHistogram taskLateness;  // ms a scheduled task ran after its deadline
+    DecentIoTHistogram tlsHandshake;  // ms per TLS connect
+};
+#endif
+
 // Scheduled task structure
 struct ScheduledTask
 {
-    unsigned long lastRun;
-    unsigned long interval;
+    DecentIoTTaskId id = 0; // 0 = free slot
+    uint64_t deadline = 0;  // on the scheduler's 64-bit millisecond clock
+    uint32_t interval = 0;
+    bool once = false;
+    size_t heapPos = SIZE_MAX; // position in the deadline heap, SIZE_MAX while not queued
     TaskCallback callback;
+    DecentIoTPriority priority = DECENTIOT_PRIORITY_NORMAL;
+    // How late the task started relative to its deadline, in ms
+    uint32_t runs = 0;
+    uint32_t lastLateness = 0;
+    uint32_t maxLateness = 0;
+    uint64_t totalLateness = 0;
+};
+
+// Start-time jitter of one task, all in ms, from getTaskJitter()
+struct DecentIoTTaskJitter
+{
+    uint32_t runs;
+    uint32_t last;
+    uint32_t max;
+    uint32_t mean;
+};
+
+struct ScheduledTaskName
+{
+    char name[DECENTIOT_MAX_TASK_NAME + 1];
+    DecentIoTTaskId id;
+};
+
+// Smallest power of two that keeps a hash table of n entries at most half full
+constexpr size_t decentIoTTableSize(size_t n, size_t size = 1)
+{
+    return size >= 2 * n ? size : decentIoTTableSize(n, size * 2);
+}
+
+class DecentIoTClass;
+
+// One logical device behind a gateway, e.g. a Modbus slave. It has its own
+// topic prefix, receive handlers and heartbeat, and publishes through the
+// connection of the DecentIoTClass it was added to, which it must outlive.
+class DecentIoTDevice
+{
+public:
+    explicit DecentIoTDevice(const char *deviceId);
+    ~DecentIoTDevice();
+    DecentIoTDevice(const DecentIoTDevice &) = delete;
+    DecentIoTDevice &operator=(const DecentIoTDevice &) = delete;
+
+    const char *id() const { return _id; }
+    void onReceive(const char *pin, ReceiveCallback callback);
+    void onReceive(DecentIoTPin pin, ReceiveCallback callback);
+    void write(const char *pin, bool value);
+    void write(const char *pin, int value);
+    void write(const char *pin, float value);
+    void write(const char *pin, const char *value);
+    void publishStatus(const char *status);
+    // An offline device (say, it stopped answering on the field bus) sends no
+    // heartbeats, so the dashboard sees it go stale like a real device would
+    void setOnline(bool online);
+    bool isOnline() const { return _online; }
+    void setHeartbeatInterval(uint32_t interval); // ms, default 30000, 0 = off
+
+private:
+    friend class DecentIoTClass;
+    char _id[DECENTIOT_MAX_DEVICE_ID + 1];
+    DecentIoTClass *_gateway = nullptr;
+    uint8_t _index = 0; // position in the gateway's _devices + 1
+    ReceiveHandlerList _receiveHandlers;
+    uint8_t _receiveSlot[DECENTIOT_PIN_COUNT];
+    // "<project>/users/<user>/datastreams/<id>/" plus room for the suffix,
+    // built by the gateway like its own _topicBuf
+    char *_topicBuf = nullptr;
+    size_t _topicPrefixLen = 0;
+    std::atomic<bool> _online{true};
+    std::atomic<bool> _heartbeatDue{true}; // send on the next run(), not after a full interval
+    uint32_t _heartbeatInterval = 30000;
+    unsigned long _lastHeartbeat = 0;
+    void _publish(const char *pin, const char *payload);
 };
 
 class DecentIoTClass
 {
+    friend class DecentIoTDevice;
+
 private:
     // Member variables - order matters for constructor
     String _projectId;
@@ -149,57 +493,332 @@ private:
     String _username;
     String _password;
     WiFiClientSecure _client;
-    PubSubClient _pubsub;  // For TLS (port 8883)
-    std::vector<ReceiveHandler> _receiveHandlers;
-    std::vector<SendHandler> _sendHandlers;
-    std::map<String, ScheduledTask> _scheduledTasks;
+    DecentIoTMqttClient _pubsub;  // For TLS (port 8883)
+    DecentIoTList<ReceiveHandler, DECENTIOT_MAX_PINS> _receiveHandlers;
+    // Pin index -> position in _receiveHandlers + 1 (0 = no handler). Custom
+    // pin names that are not P0..P50 fall back to a scan of _receiveHandlers.
+    uint8_t _receiveSlot[DECENTIOT_PIN_COUNT];
+    DecentIoTList<ReceiveStreamHandler, DECENTIOT_MAX_PINS> _streamHandlers;
+    // Decimals used when formatting floats for Pn, -1 = shortest exact
+    int8_t _pinPrecision[DECENTIOT_PIN_COUNT];
+    // Publish policies, looked up like _receiveSlot (index + 1, 0 = none)
+    DecentIoTList<PublishPolicy, DECENTIOT_MAX_PINS> _policies;
+    uint8_t _policySlot[DECENTIOT_PIN_COUNT];
+    // Sample buffers, looked up like _policies
+    DecentIoTList<SampleBuffer, DECENTIOT_MAX_SAMPLE_BUFFERS> _sampleBuffers;
+    uint8_t _sampleSlot[DECENTIOT_PIN_COUNT];
+    DecentIoTList<SendHandler, DECENTIOT_MAX_PINS> _sendHandlers;
+    // Scheduler: task slots plus a binary min-heap of slot indices keyed on
+    // deadline, so "nothing due" is a single comparison against the heap top
+    DecentIoTList<ScheduledTask, DECENTIOT_MAX_TASKS> _tasks;
+    DecentIoTList<uint16_t, DECENTIOT_MAX_TASKS> _taskHeap;
+    DecentIoTList<uint16_t, DECENTIOT_MAX_TASKS> _freeTaskSlots;
+    DecentIoTList<ScheduledTaskName, DECENTIOT_MAX_TASKS> _taskNames; // only touched by schedule()/cancel()
+    DecentIoTList<DecentIoTTaskId, DECENTIOT_MAX_TASKS> _dueTasks;    // scratch for processScheduledTasks()
+    uint64_t _schedulerClock;
+    uint32_t _schedulerLastMillis;
+
+    // Outbound ring buffer. Bit n of _fifoPins selects FIFO mode for Pn,
+    // bit 63 covers custom pin names.
+    QueuedMessage _queue[DECENTIOT_QUEUE_SIZE];
+    uint16_t _queueHead;
+    uint16_t _queueCount;
+    uint64_t _fifoPins;
+    uint32_t _queueDrops;
+    uint16_t _drainRate;           // messages per second, 0 = unlimited
+    unsigned long _lastDrain;
+    // Optional flash log that takes over from _queue for FIFO pins
+    DecentIoTOfflineLog _offlineLog;
+    uint32_t _offlineMaxAge;       // seconds, 0 = no limit
+
+    // Batch being built between beginBatch() and commitBatch(): a flat JSON
+    // object {"P1":23.5,"P2":"text"} published on "<device>/batch". Inbound
+    // batches use "<device>/batch/set" so our own retained batch never echoes.
+    char _batchBuf[DECENTIOT_BATCH_SIZE];
+    size_t _batchLen;
+    bool _batching;
+    DecentIoTSubscribeMode _subscribeMode;
+
+    // Topic buffer, built once in begin(): "<project>/users/<user>/datastreams/<device>/"
+    // followed by room for the longest "<pin>/value" suffix. The publish path only
+    // patches the suffix in place, so building a topic never allocates.
+    char *_topicBuf;
+    size_t _topicPrefixLen;
 
 #ifdef ESP8266
     BearSSL::X509List *_cert;
+    // Filled in by each full handshake and offered on the next connect, so
+    // reconnects take the abbreviated (resumed) handshake when the broker agrees
+    BearSSL::Session _tlsSession;
+    bool _insecure = false; // setInsecure() was called on _client, see _applyTrust()
 #endif
+    const char *_caCert = nullptr; // from setCACert(), nullptr = built-in root_ca
 
 public:
     DecentIoTClass();
     ~DecentIoTClass(); // Add this line
     void begin(const char *mqttBroker, int mqttPort, const char *mqttUser, const char *mqttPass, const char *projectId, const char *userId, const char *deviceId);
     void onReceive(const char *pin, ReceiveCallback callback);
+    void onReceive(DecentIoTPin pin, ReceiveCallback callback);
+    // Payloads of any size in pieces, for pins without an onReceive()
+    // handler. Called on the task that owns MQTT; see "Large Payloads".
+    void onReceiveStream(const char *pin, ReceiveStreamCallback callback);
     void onSend(const char *pin, SendCallback callback);
-    void run();
+    void run(uint32_t budgetMicros = 0); // 0 = no time limit
     void write(const char *pin, bool value);
     void write(const char *pin, int value);
     void write(const char *pin, float value);
     void write(const char *pin, const char *value);
+    // Large values without a buffer for the whole payload: the length goes
+    // out first, then append() writes straight to the socket. Connected
+    // only; endPublish() is false and the connection is dropped if fewer
+    // than length bytes were appended.
+    bool beginPublish(const char *pin, size_t length);
+    size_t append(const uint8_t *data, size_t size);
+    size_t append(const char *text);
+    bool endPublish();
+    // Safe from interrupt handlers and other tasks: no allocation, no locks,
+    // no network access. The value is published by the next run(); false
+    // if the ring is full.
+    bool writeFromISR(DecentIoTPin pin, bool value);
+    bool writeFromISR(DecentIoTPin pin, int value);
+    bool writeFromISR(DecentIoTPin pin, float value);
+    void setPrecision(const char *pin, int8_t decimals); // -1 = shortest exact (default)
+    void setDeadband(const char *pin, float deadband, DecentIoTDeadbandMode mode = DECENTIOT_DEADBAND_ABSOLUTE);
+    void setPublishInterval(const char *pin, uint32_t minInterval, uint32_t maxSilence = 0);
+    // High-rate pins: write()s are kept as timestamped samples and published
+    // as one block on "<device>/<pin>/block" once maxSamples are held or the
+    // oldest is maxAge ms old. maxSamples 0 turns it off. See DecentIoTSeries.h.
+    bool setSampleBuffer(const char *pin, uint16_t maxSamples, uint32_t maxAge = 0);
+    bool flushSamples(const char *pin);
     void publishStatus(const char *status); // for heartbeat/status
+    void beginBatch();
+    void add(const char *pin, bool value);
+    void add(const char *pin, int value);
+    void add(const char *pin, float value);
+    void add(const char *pin, const char *value);
+    bool commitBatch();
+    void setSubscribeMode(DecentIoTSubscribeMode mode);
+    void setQueueMode(DecentIoTQueueMode mode);
+    void setQueueMode(const char *pin, DecentIoTQueueMode mode);
+    void setQueueDrainRate(uint16_t messagesPerSecond);
+    size_t getQueueDepth() const;
+    uint32_t getQueueDrops() const;
+    bool setOfflineStorage(DecentIoTLogStorage *storage);
+    void setOfflineMaxAge(uint32_t seconds);
+    uint32_t getOfflineLogSize() const;
     bool connected();
     void disconnect();
     const char *getStatus();
     const char *getLastError();
     bool isSecure() const; // Check if SSL/TLS is being used
-    void schedule(uint32_t interval, TaskCallback callback);
-    void schedule(String taskId, uint32_t interval, TaskCallback callback);
-    void scheduleOnce(uint32_t delay, TaskCallback callback);
-    void cancel(String taskId);
+    uint32_t getEpochTime() const; // Unix time from the cached NTP clock, 0 until synced
+    void setReconnectBackoff(uint32_t minDelay, uint32_t maxDelay); // ms, default 5000 / 120000
+    // Gateway mode: publish and receive for `device` over this connection.
+    // Call before startNetworkTask(); devices stay registered for good.
+    bool addDevice(DecentIoTDevice &device);
+    DecentIoTDevice *getDevice(const char *deviceId);
+#if DECENTIOT_METRICS
+    const DecentIoTStats &getStats() const { return _stats; }
+    void resetStats();
+    void setMetricsInterval(uint32_t interval); // snapshot on "<device>/metrics", 0 = off
+#endif
+    DecentIoTTaskId schedule(uint32_t interval, TaskCallback callback);
+    DecentIoTTaskId schedule(const char *taskId, uint32_t interval, TaskCallback callback);
+    DecentIoTTaskId schedule(const String &taskId, uint32_t interval, TaskCallback callback);
+    DecentIoTTaskId scheduleOnce(uint32_t delay, TaskCallback callback);
+    void cancel(const char *taskId);
+    void cancel(const String &taskId);
+    void cancel(DecentIoTTaskId handle);
     void cancelSend(const char *pin);
-    void setCACert(const char *cert); 
+    void setPriority(DecentIoTTaskId handle, DecentIoTPriority priority);
+    void setPriority(const char *taskOrPin, DecentIoTPriority priority);
+    DecentIoTTaskJitter getTaskJitter(DecentIoTTaskId handle) const;
+    DecentIoTTaskJitter getTaskJitter(const char *taskOrPin) const;
+    // PEM, must stay valid; enables server verification. Best called before
+    // begin(); called later it drops an unverified connection so the next
+    // one is verified.
+    void setCACert(const char *cert);
+#if DECENTIOT_NATIVE_MQTT
+    // Carry MQTT over something other than the built-in TLS socket, e.g. a
+    // DecentIoTLoopbackTransport in a host build. Call before begin().
+    void setTransport(DecentIoTTransport &transport);
+    void setPublishQos(uint8_t qos); // 0 (default) or 1; QoS 1 waits for PUBACK, see DECENTIOT_MQTT_INFLIGHT
+    void setProtocolVersion(uint8_t version); // 5 (default, falls back to 3.1.1) or 4
+#endif
+#if DECENTIOT_NETWORK_TASK
+    // Moves MQTT/TLS onto a task pinned to `core`. Call after begin() and
+    // after registering handlers; from then on write() only enqueues.
+    bool startNetworkTask(int core = 0, uint32_t stackSize = 8192);
+    void stopNetworkTask();
+#endif
     void _subscribeAllPubSub();   // this can/should be in under private
 
 private:
-    String _getTopic(const char *pin) const;
+    void _buildTopicTable();
+    const char *_getTopic(const char *pin);
+    const char *_getDeviceTopic(const char *suffix);
+    static const char *_pinTopic(char *topicBuf, size_t prefixLen, const char *pin);
+    static const char *_suffixTopic(char *topicBuf, size_t prefixLen, const char *suffix);
+    const char *_topicFor(uint8_t device, const char *pin);
     void _handleMessage(const char *topic, const uint8_t *payload, unsigned int length);
+    void _dispatch(uint8_t device, const char *pinTopic, size_t pinTopicLen, const uint8_t *payload, unsigned int length);
+    void _publishValue(const char *pin, const char *payload, uint8_t device = 0);
+    void _publishStatus(const char *status, uint8_t device);
+    ReceiveStreamHandler *_findStreamHandler(const char *pinTopic, size_t pinTopicLen);
+    void _handleStream(const char *topic, const uint8_t *data, size_t length, size_t offset, size_t total);
+    // Open streamed publish: nothing else may touch the socket until it ends
+    bool _streaming = false;
+    size_t _streamLeft = 0;
+    bool _logValue(const char *pin, DecentIoTValue::Type type, uint32_t value);
+    bool _replayLogged();
+    bool _canPublish();
+    bool _batchAdd(const char *pin, const char *value, bool quoted);
+    void _handleBatch(const uint8_t *payload, unsigned int length);
+    void _requeueBatch();
+    void _policyBatched(PublishPolicy *policy, DecentIoTValue::Type type, double value);
+    void _settleBatchedPolicies(bool sent);
+    void _enqueue(const char *pin, const char *payload, uint8_t device = 0);
+    void _drainQueue(unsigned long currentMillis);
+    bool _isFifoPin(const char *pin) const;
+    size_t _formatFloat(const char *pin, float value, char *buffer, size_t size) const;
+    PublishPolicy *_findPolicy(const char *pin, bool create = false);
+    bool _policyAllows(PublishPolicy *policy, DecentIoTValue::Type type, double value);
+    void _policySent(PublishPolicy *policy, DecentIoTValue::Type type, double value);
+    void _processPolicies(unsigned long now);
+    bool _bufferSample(const char *pin, DecentIoTValue::Type type, uint32_t value);
+    bool _flushSamples(SampleBuffer &buffer);
+    void _processSamples(unsigned long now);
+    static void _addReceiveHandler(ReceiveHandlerList &handlers, uint8_t *slots, int pinIndex, const char *pin, ReceiveCallback callback);
+    static ReceiveHandler *_findReceiveHandler(ReceiveHandlerList &handlers, const uint8_t *slots, const char *pin, size_t pinLen);
+    static int _pinIndex(const char *pin, size_t pinLen);
     void processScheduledTasks();
-    bool isNumericString(const String &str);
+    DecentIoTTaskId _addTask(uint64_t deadline, uint32_t interval, bool once, TaskCallback callback);
+    ScheduledTask *_findTask(DecentIoTTaskId handle);
+    int _findTaskName(const char *taskId) const;
+    void _freeTask(uint16_t slot);
+    uint64_t _schedulerNow();
+    bool _taskBefore(uint16_t a, uint16_t b) const;
+    DecentIoTTaskId _findTaskHandle(const char *taskOrPin) const;
+    bool _budgetExpired() const;
+    uint32_t _runStart = 0;
+    uint32_t _runBudget = 0;
+    uint32_t _messagesRead = 0; // bumped by _handleMessage(), tells run() a packet arrived
+    void _heapPush(uint16_t slot);
+    void _heapRemove(size_t pos);
+    void _heapSiftUp(size_t pos);
+    void _heapSiftDown(size_t pos);
     unsigned long _lastStatusUpdate = 0;
     const unsigned long _statusUpdateInterval = 30000; // 30 seconds
     unsigned long _lastReconnectAttempt = 0;
-    const unsigned long _reconnectInterval = 5000; // 5 seconds between reconnection attempts
+    // Reconnect backoff: after a failure, wait a random time up to
+    // base * 2^attempts (capped at max). See _scheduleReconnect().
+    uint32_t _backoffBase = 5000;
+    uint32_t _backoffMax = 120000;
+    uint32_t _reconnectDelay = 0;
+    uint8_t _reconnectAttempts = 0;
+    void _scheduleReconnect(unsigned long currentMillis);
     unsigned long _lastConnectionCheck = 0;
     const unsigned long _connectionCheckInterval = 10000; // Check connection every 10 seconds
     bool _wasWiFiConnected = false; // Track WiFi state to detect reconnections
+
+    // Connection state machine, advanced one step per run() so nothing in the
+    // reconnect path sleeps. The longest single step is the TLS handshake,
+    // bounded by the client timeout.
+    enum ConnectionState : uint8_t
+    {
+        CONN_IDLE,          // disconnected, waiting for the next attempt
+        CONN_DISCONNECTING, // tear down the old session
+        CONN_TIME_SYNC,     // wait for a valid clock, needed to check certificates
+        CONN_TLS_HANDSHAKE,
+        CONN_MQTT_CONNECT,
+        CONN_RESUBSCRIBE,
+        CONN_CONNECTED
+    };
+    // Written only by whoever owns MQTT; the sketch side of the network task
+    // reads it instead of touching the client
+    std::atomic<ConnectionState> _connState{CONN_IDLE};
+    unsigned long _connWaitStart = 0;
+    unsigned long _connWaitMs = 0;
+    unsigned long _timeSyncStart = 0;
+    bool _timeSyncRequested = false;
+    const unsigned long _timeSyncTimeout = 7500; // give up on NTP and try TLS anyway
+    // Wall clock cached as epoch seconds at a millis() reading, so timestamps
+    // cost no syscall; 0 until SNTP first delivers a valid time
+    uint32_t _clockEpoch = 0;
+    unsigned long _clockMillis = 0;
+    unsigned long _clockLastCheck = 0;
+    bool _clockChecked = false;
+    const unsigned long _clockResyncInterval = 3600000UL; // 1 hour
+    void _updateClock(unsigned long currentMillis);
+    uint32_t _epochNow() const;
+    uint64_t _epochMillis(uint32_t at) const;
+    const char *_lastError = "";
+    DecentIoTMpscRing<IsrRecord, DECENTIOT_ISR_RING_SIZE> _isrRing;
+    std::atomic<uint32_t> _isrDrops{0};
+    bool _pushFromISR(uint8_t pin, DecentIoTValue::Type type, uint32_t value);
+    void _drainISR();
+    void _runNetwork(unsigned long currentMillis);
+    void _deliver(ReceiveHandler *handler, const uint8_t *payload, unsigned int length, uint8_t device = 0);
+    bool _offNetworkTask() const; // true on the sketch side while the network task owns MQTT
+#if DECENTIOT_NETWORK_TASK
+    DecentIoTSpscRing<QueuedMessage, DECENTIOT_RING_SIZE> _outbound; // sketch -> network; empty pin = status
+    DecentIoTSpscRing<InboundMessage, DECENTIOT_RING_SIZE> _inbound; // network -> sketch
+    DecentIoTThread _networkThread;
+    std::atomic<bool> _networkStop{false};
+    std::atomic<bool> _disconnectRequested{false};
+    std::atomic<uint32_t> _ringDrops{0};
+    static void _networkTaskEntry(void *self);
+    void _networkLoop();
+    void _networkPublish(const QueuedMessage &msg);
+    void _pushOutbound(const char *pin, const char *payload, uint8_t device = 0);
+    void _deliverInbound();
+#endif
+#if DECENTIOT_METRICS
+    DecentIoTStats _stats;
+    bool _hadSession = false;
+    unsigned long _sessionLostAt = 0;
+    uint32_t _metricsInterval = 0;
+    unsigned long _lastMetrics = 0;
+    DecentIoTPinStats &_pinStats(const char *pin);
+    void _sessionLost();
+    void _publishMetrics();
+#endif
     void _publishDeviceStatus(bool online);
+
+    // Gateway devices, found from an inbound topic through an open-addressing
+    // hash table on the device ID (position in _devices + 1, 0 = empty)
+    static constexpr size_t _deviceTableSize = decentIoTTableSize(DECENTIOT_MAX_DEVICES);
+    DecentIoTList<DecentIoTDevice *, DECENTIOT_MAX_DEVICES> _devices;
+    uint8_t _deviceTable[_deviceTableSize];
+    size_t _datastreamsLen = 0; // length of "<project>/users/<user>/datastreams/"
+    static uint32_t _hashDeviceId(const char *id, size_t len);
+    DecentIoTDevice *_findDevice(const char *id, size_t len);
+    void _buildDeviceTopic(DecentIoTDevice &device);
+    void _subscribeDevice(DecentIoTDevice &device);
+    void _publishHeartbeat(DecentIoTDevice &device, unsigned long currentMillis);
+    void _processHeartbeats(unsigned long currentMillis);
     void handleReconnection();
-    bool reconnectMQTT();
+    void _startConnection(unsigned long settleMs);
+    void _connectionWait(unsigned long ms);
+    bool _advanceConnection();
+    void _configureClient();
+    bool _publishRetained(const char *topic, const char *payload, const char *pin, uint8_t device);
+#if DECENTIOT_NATIVE_MQTT
+    // MQTT 5 topic aliases for P0..P50 of this device, handed out in order of
+    // first publish on each connection until the broker's maximum (0 = none)
+    uint8_t _topicAlias[DECENTIOT_PIN_COUNT];
+    uint8_t _aliasCount = 0;
+    uint16_t _aliasFor(const char *pin);
+#endif
+    bool _openSocket();
+    void _closeSocket();
+    void _applyTrust();
+    static void _makeClientId(char *buffer, size_t size);
 };
 
+static_assert(DECENTIOT_MAX_DEVICES < 255, "device index must fit in uint8_t");
+
 extern DecentIoTClass DecentIoT;
 DecentIoTClass &getDecentIoT();
 
@@ -233,7 +852,8 @@ public:
         if (interval > 0)
         {
             // If interval is provided, create a scheduled task
-            String taskId = String("send_") + pin;
+            char taskId[DECENTIOT_MAX_TASK_NAME + 1];
+            snprintf(taskId, sizeof(taskId), "send_%s", pin);
             getDecentIoT().schedule(taskId, interval, cb);
         }
         else
@@ -244,55 +864,60 @@ public:
     }
 };
 
-// Pin definitions (same as OpenIoT for consistency)
-#define P0 "P0"
-#define P1 "P1"
-#define P2 "P2"
-#define P3 "P3"
-#define P4 "P4"
-#define P5 "P5"
-#define P6 "P6"
-#define P7 "P7"
-#define P8 "P8"
-#define P9 "P9"
-#define P10 "P10"
-#define P11 "P11"
-#define P12 "P12"
-#define P13 "P13"
-#define P14 "P14"
-#define P15 "P15"
-#define P16 "P16"
-#define P17 "P17"
-#define P18 "P18"
-#define P19 "P19"
-#define P20 "P20"
-#define P21 "P21"
-#define P22 "P22"
-#define P23 "P23"
-#define P24 "P24"
-#define P25 "P25"
-#define P26 "P26"
-#define P27 "P27"
-#define P28 "P28"
-#define P29 "P29"
-#define P30 "P30"
-#define P31 "P31"
-#define P32 "P32"
-#define P33 "P33"
-#define P34 "P34"
-#define P35 "P35"
-#define P36 "P36"
-#define P37 "P37"
-#define P38 "P38"
-#define P39 "P39"
-#define P40 "P40"
-#define P41 "P41"
-#define P42 "P42"
-#define P43 "P43"
-#define P44 "P44"
-#define P45 "P45"
-#define P46 "P46"
-#define P47 "P47"
-#define P48 "P48"
-#define P49 "P49"
-#define P50 "P50"
\ No newline at end of file
+// The pin name as a string literal, for building strings at compile time:
+// "prefix/" DECENTIOT_PIN_NAME(1) is "prefix/P1". P1 itself is no longer a
+// literal and cannot be pasted like this.
+#define DECENTIOT_PIN_NAME(n) "P" #n
+
+// Pin definitions (same names as OpenIoT for consistency, indices fixed at compile time)
+#define P0 DecentIoTPin(0, "P0")
+#define P1 DecentIoTPin(1, "P1")
+#define P2 DecentIoTPin(2, "P2")
+#define P3 DecentIoTPin(3, "P3")
+#define P4 DecentIoTPin(4, "P4")
+#define P5 DecentIoTPin(5, "P5")
+#define P6 DecentIoTPin(6, "P6")
+#define P7 DecentIoTPin(7, "P7")
+#define P8 DecentIoTPin(8, "P8")
+#define P9 DecentIoTPin(9, "P9")
+#define P10 DecentIoTPin(10, "P10")
+#define P11 DecentIoTPin(11, "P11")
+#define P12 DecentIoTPin(12, "P12")
+#define P13 DecentIoTPin(13, "P13")
+#define P14 DecentIoTPin(14, "P14")
+#define P15 DecentIoTPin(15, "P15")
+#define P16 DecentIoTPin(16, "P16")
+#define P17 DecentIoTPin(17, "P17")
+#define P18 DecentIoTPin(18, "P18")
+#define P19 DecentIoTPin(19, "P19")
+#define P20 DecentIoTPin(20, "P20")
+#define P21 DecentIoTPin(21, "P21")
+#define P22 DecentIoTPin(22, "P22")
+#define P23 DecentIoTPin(23, "P23")
+#define P24 DecentIoTPin(24, "P24")
+#define P25 DecentIoTPin(25, "P25")
+#define P26 DecentIoTPin(26, "P26")
+#define P27 DecentIoTPin(27, "P27")
+#define P28 DecentIoTPin(28, "P28")
+#define P29 DecentIoTPin(29, "P29")
+#define P30 DecentIoTPin(30, "P30")
+#define P31 DecentIoTPin(31, "P31")
+#define P32 DecentIoTPin(32, "P32")
+#define P33 DecentIoTPin(33, "P33")
+#define P34 DecentIoTPin(34, "P34")
+#define P35 DecentIoTPin(35, "P35")
+#define P36 DecentIoTPin(36, "P36")
+#define P37 DecentIoTPin(37, "P37")
+#define P38 DecentIoTPin(38, "P38")
+#define P39 DecentIoTPin(39, "P39")
+#define P40 DecentIoTPin(40, "P40")
+#define P41 DecentIoTPin(41, "P41")
+#define P42 DecentIoTPin(42, "P42")
+#define P43 DecentIoTPin(43, "P43")
+#define P44 DecentIoTPin(44, "P44")
+#define P45 DecentIoTPin(45, "P45")
+#define P46 DecentIoTPin(46, "P46")
+#define P47 DecentIoTPin(47, "P47")
+#define P48 DecentIoTPin(48, "P48")
+#define P49 DecentIoTPin(49, "P49")
+#define P50 DecentIoTPin(50, "P50")
\ No newline at end of file
@@ -0,0 +1,100 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoT.h"
+
+DecentIoTDevice::DecentIoTDevice(const char *deviceId)
+{
+    // IDs become a topic level, so they cannot contain separators or wildcards
+    size_t len = strlen(deviceId);
+    if (len == 0 || len > DECENTIOT_MAX_DEVICE_ID || strpbrk(deviceId, "/+#") != nullptr)
+    {
+        Serial.printf("[DecentIoT] Invalid device ID: %s\n", deviceId);
+        len = 0;
+    }
+    memcpy(_id, deviceId, len);
+    _id[len] = '\0';
+    memset(_receiveSlot, 0, sizeof(_receiveSlot));
+}
+
+DecentIoTDevice::~DecentIoTDevice()
+{
+    delete[] _topicBuf;
+    _topicBuf = nullptr;
+}
+
+void DecentIoTDevice::onReceive(const char *pin, ReceiveCallback callback)
+{
+    DecentIoTClass::_addReceiveHandler(_receiveHandlers, _receiveSlot,
+                                       DecentIoTClass::_pinIndex(pin, strlen(pin)), pin, callback);
+}
+
+void DecentIoTDevice::onReceive(DecentIoTPin pin, ReceiveCallback callback)
+{
+    DecentIoTClass::_addReceiveHandler(_receiveHandlers, _receiveSlot, pin.id, pin.name, callback);
+}
+
+void DecentIoTDevice::write(const char *pin, bool value)
+{
+    _publish(pin, value ? "true" : "false");
+}
+void DecentIoTDevice::write(const char *pin, int value)
+{
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatInt(value, buffer, sizeof(buffer));
+    _publish(pin, buffer);
+}
+void DecentIoTDevice::write(const char *pin, float value)
+{
+    char buffer[DECENTIOT_NUMBER_BUFFER];
+    DecentIoTFormat::formatFloat(value, -1, buffer, sizeof(buffer));
+    _publish(pin, buffer);
+}
+void DecentIoTDevice::write(const char *pin, const char *value)
+{
+    _publish(pin, value);
+}
+
+void DecentIoTDevice::publishStatus(const char *status)
+{
+    if (_gateway != nullptr)
+        _gateway->_publishStatus(status, _index);
+}
+
+void DecentIoTDevice::setOnline(bool online)
+{
+    // Coming back announces itself right away instead of after an interval
+    if (online && !_online)
+        _heartbeatDue = true;
+    _online = online;
+}
+
+void DecentIoTDevice::setHeartbeatInterval(uint32_t interval)
+{
+    _heartbeatInterval = interval;
+}
+
+// Goes through the gateway's offline queue like DecentIoT.write()
+void DecentIoTDevice::_publish(const char *pin, const char *payload)
+{
+    if (_gateway == nullptr)
+    {
+        Serial.printf("[DecentIoT] Device %s was not added to a gateway\n", _id);
+        return;
+    }
+    _gateway->_publishValue(pin, payload, _index);
+}
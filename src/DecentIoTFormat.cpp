@@ -0,0 +1,244 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTFormat.h"
+#include <math.h>
+#include <string.h>
+
+static const uint64_t kPow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL};
+
+// Every power of ten up to 1e22 is exact in a double
+static const double kPow10Exact[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Digits of value, most significant first; returns the count
+static size_t writeDigits(uint64_t value, char *out)
+{
+    char reversed[20];
+    size_t n = 0;
+    do
+    {
+        reversed[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < n; i++)
+        out[i] = reversed[n - 1 - i];
+    return n;
+}
+
+// |value| with `decimals` digits after the point; ".0" if decimals == 0
+static size_t writeFixed(bool negative, double magnitude, uint8_t decimals, char *out)
+{
+    uint64_t scaled = (uint64_t)llround(magnitude * kPow10[decimals]);
+    char *p = out;
+    if (negative)
+        *p++ = '-';
+    p += writeDigits(scaled / kPow10[decimals], p);
+    *p++ = '.';
+    if (decimals == 0)
+        *p++ = '0';
+    uint64_t fraction = scaled % kPow10[decimals];
+    for (int d = decimals - 1; d >= 0; d--)
+        *p++ = '0' + (fraction / kPow10[d]) % 10;
+    return p - out;
+}
+
+// Fewest significant digits (1..9) that parse back to value, as an integer
+// `digits` with the leading one at 10^exponent. At each length only the two
+// integers either side of the scaled value can round-trip; nine digits
+// always do for a float.
+static uint8_t shortestDigits(float value, uint32_t &digits, int &exponent)
+{
+    double magnitude = fabs((double)value);
+    int binaryExponent;
+    frexp(magnitude, &binaryExponent);
+    // floor(log10(magnitude)), or one less
+    exponent = (int)floor((binaryExponent - 1) * 0.30102999566398120);
+    if (DecentIoTFormat::scalePow10(magnitude, -(exponent + 1)) >= 1.0)
+        exponent++;
+
+    float target = fabsf(value);
+    for (uint8_t count = 1; count <= 9; count++)
+    {
+        double scaled = DecentIoTFormat::scalePow10(magnitude, (count - 1) - exponent);
+        uint32_t below = (uint32_t)scaled;
+        uint32_t nearer = scaled - below >= 0.5 ? below + 1 : below;
+        uint32_t candidates[2] = {nearer, nearer == below ? below + 1 : below};
+        for (uint8_t i = 0; i < 2; i++)
+        {
+            uint32_t candidate = candidates[i];
+            int candidateExponent = exponent;
+            if (candidate >= kPow10[count])
+            {
+                // Rounded up into a new digit, e.g. 9.99 -> 10
+                candidate /= 10;
+                candidateExponent++;
+            }
+            if ((float)DecentIoTFormat::scalePow10(candidate, candidateExponent - (count - 1)) == target)
+            {
+                digits = candidate;
+                exponent = candidateExponent;
+                return count;
+            }
+        }
+    }
+    // Not reached for finite floats; nine rounded digits as a fallback
+    digits = (uint32_t)llround(DecentIoTFormat::scalePow10(magnitude, 8 - exponent));
+    return 9;
+}
+
+// count digits with the leading one at 10^exponent, as plain decimals with
+// at least one digit after the point
+static size_t writePlain(bool negative, const char *digits, uint8_t count, int exponent, char *out)
+{
+    char *p = out;
+    if (negative)
+        *p++ = '-';
+    if (exponent < 0)
+    {
+        *p++ = '0';
+        *p++ = '.';
+        for (int i = -1; i > exponent; i--)
+            *p++ = '0';
+        memcpy(p, digits, count);
+        return p + count - out;
+    }
+    for (int i = 0; i <= exponent; i++)
+        *p++ = i < count ? digits[i] : '0';
+    *p++ = '.';
+    if (count > exponent + 1)
+    {
+        memcpy(p, digits + exponent + 1, count - exponent - 1);
+        p += count - exponent - 1;
+    }
+    else
+    {
+        *p++ = '0';
+    }
+    return p - out;
+}
+
+// Same digits as d.ddd...e[-]x
+static size_t writeExponent(bool negative, const char *digits, uint8_t count, int exponent, char *out)
+{
+    char *p = out;
+    if (negative)
+        *p++ = '-';
+    *p++ = digits[0];
+    if (count > 1)
+    {
+        *p++ = '.';
+        memcpy(p, digits + 1, count - 1);
+        p += count - 1;
+    }
+    *p++ = 'e';
+    if (exponent < 0)
+    {
+        *p++ = '-';
+        exponent = -exponent;
+    }
+    p += writeDigits(exponent, p);
+    return p - out;
+}
+
+static size_t copyOut(const char *text, size_t length, char *buffer, size_t size)
+{
+    if (size == 0)
+        return 0;
+    if (length + 1 > size)
+    {
+        buffer[0] = '\0';
+        return 0;
+    }
+    memcpy(buffer, text, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+size_t DecentIoTFormat::formatInt(int32_t value, char *buffer, size_t size)
+{
+    char text[12];
+    char *p = text;
+    uint32_t magnitude = (uint32_t)value;
+    if (value < 0)
+    {
+        *p++ = '-';
+        magnitude = 0U - magnitude;
+    }
+    p += writeDigits(magnitude, p);
+    return copyOut(text, p - text, buffer, size);
+}
+
+size_t DecentIoTFormat::formatUint(uint32_t value, char *buffer, size_t size)
+{
+    char text[11];
+    return copyOut(text, writeDigits(value, text), buffer, size);
+}
+
+size_t DecentIoTFormat::formatFloat(float value, int8_t decimals, char *buffer, size_t size)
+{
+    char text[DECENTIOT_NUMBER_BUFFER];
+    size_t length = 0;
+
+    if (isnan(value))
+        return copyOut("nan", 3, buffer, size);
+    if (isinf(value))
+        return value < 0 ? copyOut("-inf", 4, buffer, size) : copyOut("inf", 3, buffer, size);
+
+    bool negative = signbit(value);
+    double magnitude = fabs((double)value);
+    bool fixedRange = magnitude == 0.0 || (magnitude >= 1e-4 && magnitude < 1e9);
+
+    if (magnitude == 0.0 || (decimals >= 0 && fixedRange))
+    {
+        length = writeFixed(negative, magnitude, decimals < 0 ? 1 : decimals > 9 ? 9 : decimals, text);
+        return copyOut(text, length, buffer, size);
+    }
+
+    uint32_t digits;
+    int exponent;
+    uint8_t count = shortestDigits(value, digits, exponent);
+    char digitText[10];
+    writeDigits(digits, digitText);
+    if (fixedRange)
+        length = writePlain(negative, digitText, count, exponent, text);
+    else
+        length = writeExponent(negative, digitText, count, exponent, text);
+    return copyOut(text, length, buffer, size);
+}
+
+// Multi-step scales (beyond 1e22) can be off by an ulp of the double, far
+// below what a float resolves
+double DecentIoTFormat::scalePow10(double value, int exponent)
+{
+    if (value == 0.0)
+        return value;
+    while (exponent > 22)
+    {
+        value *= 1e22;
+        exponent -= 22;
+    }
+    while (exponent < -22)
+    {
+        value /= 1e22;
+        exponent += 22;
+    }
+    return exponent < 0 ? value / kPow10Exact[-exponent] : value * kPow10Exact[exponent];
+}
@@ -0,0 +1,42 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+// Big enough for any formatInt()/formatFloat() result, terminator included
+#define DECENTIOT_NUMBER_BUFFER 24
+
+// Bounded number formatting for outgoing payloads, without printf or pow()
+struct DecentIoTFormat
+{
+    // Writes the decimal form of value. Returns the length, or 0 (and an
+    // empty string) if it does not fit in size bytes.
+    static size_t formatInt(int32_t value, char *buffer, size_t size);
+    static size_t formatUint(uint32_t value, char *buffer, size_t size);
+
+    // decimals < 0: shortest text that parses back (via DecentIoTValue) to
+    // exactly the same float. decimals 0..9: fixed number of decimals, where
+    // 0 still writes ".0". Either way the text has a '.' or exponent so it
+    // stays a FLOAT. Very large or small magnitudes use exponent notation.
+    // Same return contract as formatInt().
+    static size_t formatFloat(float value, int8_t decimals, char *buffer, size_t size);
+
+    // value * 10^exponent using exact powers of ten from a table
+    static double scalePow10(double value, int exponent);
+};
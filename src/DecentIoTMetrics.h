@@ -0,0 +1,92 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+// Runtime counters, enabled with -DDECENTIOT_METRICS=1. Like the static
+// limits this must be a build flag so the library and sketch agree. When
+// it is 0 every DECENTIOT_STAT() line compiles to nothing.
+
+#include <stdint.h>
+
+#ifndef DECENTIOT_METRICS
+#define DECENTIOT_METRICS 0
+#endif
+
+#if DECENTIOT_METRICS
+#define DECENTIOT_STAT(statement) statement
+#else
+#define DECENTIOT_STAT(statement) do {} while (0)
+#endif
+
+#define DECENTIOT_HISTOGRAM_BUCKETS 24
+
+// Log2 histogram: bucket 0 counts zeros, bucket b counts [2^(b-1), 2^b).
+// Recording is a count-leading-zeros and three adds, no division.
+struct DecentIoTHistogram
+{
+    uint32_t buckets[DECENTIOT_HISTOGRAM_BUCKETS] = {};
+    uint32_t count = 0;
+    uint32_t max = 0;
+    uint64_t total = 0;
+
+    void record(uint32_t value)
+    {
+        unsigned bucket = value == 0 ? 0 : 32 - __builtin_clz(value);
+        if (bucket >= DECENTIOT_HISTOGRAM_BUCKETS)
+            bucket = DECENTIOT_HISTOGRAM_BUCKETS - 1;
+        buckets[bucket]++;
+        count++;
+        total += value;
+        if (value > max)
+            max = value;
+    }
+
+    uint32_t mean() const
+    {
+        return count == 0 ? 0 : (uint32_t)(total / count);
+    }
+
+    // Upper bound of the bucket holding the given percentile (0-100)
+    uint32_t percentile(uint8_t percent) const
+    {
+        if (count == 0)
+            return 0;
+        uint64_t rank = ((uint64_t)count * percent + 99) / 100;
+        uint64_t seen = 0;
+        for (unsigned b = 0; b < DECENTIOT_HISTOGRAM_BUCKETS; b++)
+        {
+            seen += buckets[b];
+            if (seen >= rank && seen > 0)
+            {
+                uint32_t upper = b == 0 ? 0 : (b >= 32 ? UINT32_MAX : (uint32_t)((1ULL << b) - 1));
+                return upper < max ? upper : max;
+            }
+        }
+        return max;
+    }
+};
+
+// Traffic for one pin
+struct DecentIoTPinStats
+{
+    uint32_t publishes = 0;
+    uint32_t drops = 0; // lost from the offline queue or too large to queue
+    uint32_t received = 0;
+    uint32_t bytesSent = 0;
+    uint32_t bytesReceived = 0;
+};
@@ -0,0 +1,966 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTMqtt.h"
+
+// Fixed header, first byte
+static const uint8_t kConnect = 0x10;
+static const uint8_t kConnack = 0x20;
+static const uint8_t kPublish = 0x30;
+static const uint8_t kPuback = 0x40;
+static const uint8_t kSubscribe = 0x82; // reserved flags 0010
+static const uint8_t kPingreq = 0xC0;
+static const uint8_t kDisconnect = 0xE0;
+static const uint8_t kDupFlag = 0x08;
+
+// MQTT 5 property identifiers used here
+static const uint8_t kReceiveMaximum = 0x21;
+static const uint8_t kTopicAliasMaximum = 0x22;
+static const uint8_t kTopicAlias = 0x23;
+
+// CONNACK code -> state(). MQTT 5 reason codes are folded into the 3.1.1
+// ones so reconnect backoff reacts the same way to both.
+static int connackState(uint8_t version, uint8_t code)
+{
+    if (version < 5 || code < 0x80)
+        return code; // 0x01 from a 3.1.1 broker: protocol level refused
+    switch (code)
+    {
+    case 0x84:
+        return MQTT_CONNECT_BAD_PROTOCOL;
+    case 0x85:
+        return MQTT_CONNECT_BAD_CLIENT_ID;
+    case 0x86:
+        return MQTT_CONNECT_BAD_CREDENTIALS;
+    case 0x87:
+        return MQTT_CONNECT_UNAUTHORIZED;
+    case 0x88:
+    case 0x89:
+        return MQTT_CONNECT_UNAVAILABLE;
+    default:
+        return MQTT_CONNECT_FAILED;
+    }
+}
+
+DecentIoTMqtt::DecentIoTMqtt(Client &client) : _clientTransport(client), _transport(&_clientTransport)
+{
+}
+
+DecentIoTMqtt::~DecentIoTMqtt()
+{
+    delete[] _rxBuf;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setClient(Client &client)
+{
+    _clientTransport.setClient(client);
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setTransport(DecentIoTTransport &transport)
+{
+    _transport = &transport;
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setServer(const char *host, uint16_t port)
+{
+    _host = host;
+    _port = port;
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setCallback(Callback callback)
+{
+    _callback = callback;
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setStreamCallback(StreamCallback callback)
+{
+    _streamCallback = callback;
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setKeepAlive(uint16_t seconds)
+{
+    _keepAlive = seconds;
+    return *this;
+}
+
+DecentIoTMqtt &DecentIoTMqtt::setSocketTimeout(uint16_t seconds)
+{
+    _socketTimeout = seconds;
+    return *this;
+}
+
+bool DecentIoTMqtt::setBufferSize(uint16_t size)
+{
+    if (size < 8)
+        return false;
+    _maxPacket = size;
+    // Shrinking takes effect now, growing only once a packet needs it
+    if (_rxCapacity > size && _rxState != RX_BODY)
+    {
+        delete[] _rxBuf;
+        _rxBuf = nullptr;
+        _rxCapacity = 0;
+    }
+    return true;
+}
+
+void DecentIoTMqtt::setPublishQos(uint8_t qos)
+{
+    _publishQos = qos > 1 ? 1 : qos;
+}
+
+void DecentIoTMqtt::setProtocolVersion(uint8_t version)
+{
+    _maxVersion = version == 4 ? 4 : 5;
+    _version = _maxVersion;
+}
+
+size_t DecentIoTMqtt::encodeLength(uint32_t length, uint8_t *out)
+{
+    size_t n = 0;
+    do
+    {
+        uint8_t digit = length & 0x7F;
+        length >>= 7;
+        if (length > 0)
+            digit |= 0x80;
+        out[n++] = digit;
+    } while (length > 0 && n < 4);
+    return n;
+}
+
+bool DecentIoTMqtt::connect(const char *id, const char *user, const char *pass)
+{
+    if (!_openTransport())
+        return false;
+    // Every connect starts at the configured level, so one refusal (or a
+    // broker upgraded since) does not pin the client to 3.1.1 for good
+    _version = _maxVersion;
+    int result = _handshake(id, user, pass);
+    if (result == MQTT_CONNECT_BAD_PROTOCOL && _version == 5)
+    {
+        // Explicit refusal of level 5: 0x01 from a 3.1.1 broker, 0x84 from v5
+        _version = 4;
+        if (!_openTransport())
+            return false;
+        result = _handshake(id, user, pass);
+    }
+    return result == MQTT_CONNECTED;
+}
+
+bool DecentIoTMqtt::_openTransport()
+{
+    if (!_transport->connected() && (_host == nullptr || !_transport->connect(_host, _port)))
+    {
+        _state = MQTT_CONNECT_FAILED;
+        return false;
+    }
+    return true;
+}
+
+// Sends CONNECT and waits for CONNACK; returns the new state()
+int DecentIoTMqtt::_handshake(const char *id, const char *user, const char *pass)
+{
+    _rxState = RX_HEADER;
+    _aliasMax = 0;
+    _aliasSent = 0;
+    _sendQuota = DECENTIOT_MQTT_INFLIGHT;
+
+    // Protocol name "MQTT", level 5 or 4 (3.1.1), clean session
+    const uint8_t protocol[] = {0, 4, 'M', 'Q', 'T', 'T', _version};
+    uint8_t flags = 0x02;
+    uint32_t remaining = sizeof(protocol) + 3 + 2 + strlen(id);
+    if (_version >= 5)
+        remaining += 1; // empty property list
+    if (user != nullptr)
+    {
+        flags |= 0x80;
+        remaining += 2 + strlen(user);
+    }
+    if (pass != nullptr)
+    {
+        flags |= 0x40;
+        remaining += 2 + strlen(pass);
+    }
+    uint8_t variable[4] = {flags, (uint8_t)(_keepAlive >> 8), (uint8_t)_keepAlive, 0};
+    bool sent = _txBegin(kConnect, remaining) && _txAppend(protocol, sizeof(protocol)) &&
+                _txAppend(variable, _version >= 5 ? 4 : 3) && _txString(id) &&
+                (user == nullptr || _txString(user)) && (pass == nullptr || _txString(pass)) && _txFlush();
+    if (!sent)
+    {
+        _lost(MQTT_CONNECT_FAILED);
+        return _state;
+    }
+
+    // Wait for CONNACK, bounded by the socket timeout as in PubSubClient
+    unsigned long start = millis();
+    while (millis() - start < _socketTimeout * 1000UL && _transport->connected())
+    {
+        if (_transport->available() <= 0)
+        {
+            delay(1);
+            continue;
+        }
+        if (!_readPacket() || (_rxHeader & 0xF0) != kConnack)
+            continue;
+        int result = _rxLength < 2 ? MQTT_CONNECT_FAILED : connackState(_version, _rxBuf[1]);
+        if (result != MQTT_CONNECTED)
+        {
+            _lost(result);
+            return _state;
+        }
+        _readConnack();
+        _state = MQTT_CONNECTED;
+        _lastIn = _lastOut = millis();
+        _pingOutstanding = false;
+        _resendInflight();
+        return _state;
+    }
+    // No CONNACK: a dropped socket or a timeout is not a protocol refusal
+    _lost(_transport->connected() ? MQTT_CONNECTION_TIMEOUT : MQTT_CONNECTION_LOST);
+    return _state;
+}
+
+// MQTT 5 CONNACK properties: how many aliases and unacknowledged QoS 1
+// publishes the broker accepts
+void DecentIoTMqtt::_readConnack()
+{
+    if (_version < 5 || _rxLength < 3)
+        return;
+    const uint8_t *p = _rxBuf + 2;
+    const uint8_t *end = _rxBuf + _rxLength;
+    uint32_t length;
+    if (!_readVarInt(p, end, length) || length > (uint32_t)(end - p))
+        return;
+    end = p + length;
+    while (p < end)
+    {
+        uint8_t id = *p++;
+        if ((id == kTopicAliasMaximum || id == kReceiveMaximum) && end - p >= 2)
+        {
+            uint16_t value = ((uint16_t)p[0] << 8) | p[1];
+            if (id == kTopicAliasMaximum)
+                _aliasMax = value < 64 ? value : 64; // tracked in _aliasSent
+            else if (value > 0 && value < _sendQuota)
+                _sendQuota = value;
+        }
+        if (!_skipProperty(id, p, end))
+            return;
+    }
+}
+
+bool DecentIoTMqtt::_readVarInt(const uint8_t *&p, const uint8_t *end, uint32_t &value)
+{
+    value = 0;
+    for (uint8_t shift = 0; shift < 28 && p < end; shift += 7)
+    {
+        uint8_t digit = *p++;
+        value |= (uint32_t)(digit & 0x7F) << shift;
+        if (!(digit & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// Advances p past the value of property id; false if it is unknown or cut short
+bool DecentIoTMqtt::_skipProperty(uint8_t id, const uint8_t *&p, const uint8_t *end)
+{
+    size_t size;
+    switch (id)
+    {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+        size = 1;
+        break;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+        size = 2;
+        break;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+        size = 4;
+        break;
+    case 0x0B:
+    {
+        uint32_t value;
+        return _readVarInt(p, end, value);
+    }
+    case 0x26: // user property: two strings
+        return _skipProperty(0x03, p, end) && _skipProperty(0x03, p, end);
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+        if (end - p < 2)
+            return false;
+        size = 2 + (((size_t)p[0] << 8) | p[1]);
+        break;
+    default:
+        return false;
+    }
+    if ((size_t)(end - p) < size)
+        return false;
+    p += size;
+    return true;
+}
+
+bool DecentIoTMqtt::connected()
+{
+    if (_state == MQTT_CONNECTED && !_transport->connected())
+        _lost(MQTT_CONNECTION_LOST);
+    return _state == MQTT_CONNECTED;
+}
+
+void DecentIoTMqtt::disconnect()
+{
+    if (_state == MQTT_CONNECTED)
+    {
+        uint8_t packet[2] = {kDisconnect, 0};
+        _writeAll(packet, sizeof(packet));
+    }
+    _lost(MQTT_DISCONNECTED);
+}
+
+bool DecentIoTMqtt::publish(const char *topic, const char *payload, bool retained)
+{
+    return publish(topic, reinterpret_cast<const uint8_t *>(payload), strlen(payload), retained, _publishQos);
+}
+
+bool DecentIoTMqtt::publish(const char *topic, const uint8_t *payload, size_t length, bool retained, uint8_t qos)
+{
+    return publish(topic, payload, length, retained, qos, 0);
+}
+
+bool DecentIoTMqtt::publish(const char *topic, const uint8_t *payload, size_t length, bool retained, uint8_t qos,
+                            uint16_t alias)
+{
+    size_t topicLen = strlen(topic);
+    if (!connected() || _streamOpen || qos > 1 || topicLen > 0xFFFF)
+        return false;
+    if (_version < 5 || alias > _aliasMax)
+        alias = 0;
+    uint64_t aliasBit = alias ? 1ULL << (alias - 1) : 0;
+    // QoS 1 packets may be resent on a new connection that does not know
+    // the alias yet, so they always carry the topic as well
+    size_t wireTopicLen = (qos == 0 && (_aliasSent & aliasBit)) ? 0 : topicLen;
+    uint8_t properties[4] = {0, kTopicAlias, (uint8_t)(alias >> 8), (uint8_t)alias};
+    size_t propertiesLen = 0;
+    if (_version >= 5)
+    {
+        properties[0] = alias ? 3 : 0;
+        propertiesLen = alias ? 4 : 1;
+    }
+    uint32_t remaining = 2 + wireTopicLen + (qos ? 2 : 0) + propertiesLen + length;
+    uint8_t header = kPublish | (qos << 1) | (retained ? 1 : 0);
+
+    if (qos == 0)
+    {
+        // Header and topic go through _tx, a large payload straight from the caller
+        uint8_t topicPrefix[2] = {(uint8_t)(wireTopicLen >> 8), (uint8_t)wireTopicLen};
+        bool sent = _txBegin(header, remaining) && _txAppend(topicPrefix, sizeof(topicPrefix)) &&
+                    _txAppend(topic, wireTopicLen) && _txAppend(properties, propertiesLen) &&
+                    _txAppend(payload, length) && _txFlush();
+        if (!sent)
+            _lost(MQTT_CONNECTION_LOST);
+        else
+            _aliasSent |= aliasBit;
+        return sent;
+    }
+
+    // QoS 1 keeps the encoded packet until PUBACK, so it can be resent after
+    // a reconnect. A full window is backpressure: the caller queues instead.
+    uint8_t lengthBytes[4];
+    size_t lengthLen = encodeLength(remaining, lengthBytes);
+    size_t total = 1 + lengthLen + remaining;
+    if (inflight() >= _sendQuota || total > DECENTIOT_MQTT_INFLIGHT_PACKET)
+        return false;
+    Inflight *slot = nullptr;
+    for (auto &candidate : _inflight)
+    {
+        if (candidate.id == 0)
+        {
+            slot = &candidate;
+            break;
+        }
+    }
+    if (slot == nullptr)
+        return false;
+
+    uint16_t id = _packetId();
+    uint8_t *packet = slot->packet;
+    uint8_t *p = packet;
+    *p++ = header;
+    memcpy(p, lengthBytes, lengthLen);
+    p += lengthLen;
+    *p++ = topicLen >> 8;
+    *p++ = topicLen & 0xFF;
+    memcpy(p, topic, topicLen);
+    p += topicLen;
+    *p++ = id >> 8;
+    *p++ = id & 0xFF;
+    memcpy(p, properties, propertiesLen);
+    p += propertiesLen;
+    memcpy(p, payload, length);
+
+    slot->id = id;
+    slot->length = total;
+    slot->order = _inflightOrder++;
+    slot->version = _version;
+    slot->topicLen = (uint16_t)topicLen;
+    slot->alias = _version >= 5 ? alias : 0;
+    // Accepted for delivery even if the write fails: it goes out again on reconnect
+    if (_writeAll(packet, total))
+        _aliasSent |= aliasBit;
+    else
+        _lost(MQTT_CONNECTION_LOST);
+    return true;
+}
+
+bool DecentIoTMqtt::beginPublish(const char *topic, unsigned int length, bool retained)
+{
+    size_t topicLen = strlen(topic);
+    if (!connected() || _streamOpen || topicLen > 0xFFFF)
+        return false;
+    uint32_t remaining = 2 + topicLen + (_version >= 5 ? 1 : 0) + length;
+    uint8_t noProperties = 0;
+    // Left in _tx so the header shares a socket write with the first bytes
+    bool started = _txBegin(kPublish | (retained ? 1 : 0), remaining) && _txString(topic) &&
+                   _txAppend(&noProperties, _version >= 5 ? 1 : 0);
+    if (!started)
+    {
+        _lost(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    _streamLeft = length;
+    _streamOpen = true;
+    return true;
+}
+
+size_t DecentIoTMqtt::write(uint8_t byte)
+{
+    return write(&byte, 1);
+}
+
+size_t DecentIoTMqtt::write(const uint8_t *data, size_t size)
+{
+    if (size > _streamLeft)
+        size = _streamLeft;
+    if (size == 0)
+        return 0;
+    if (!_txAppend(data, size))
+    {
+        _lost(MQTT_CONNECTION_LOST);
+        return 0;
+    }
+    _streamLeft -= size;
+    return size;
+}
+
+int DecentIoTMqtt::endPublish()
+{
+    if (!_streamOpen)
+        return 0;
+    _streamOpen = false;
+    if (_streamLeft > 0)
+    {
+        // The broker would read the next packet as the rest of this payload
+        _lost(MQTT_CONNECTION_LOST);
+        return 0;
+    }
+    if (!_txFlush())
+    {
+        _lost(MQTT_CONNECTION_LOST);
+        return 0;
+    }
+    return 1;
+}
+
+bool DecentIoTMqtt::subscribe(const char *topic, uint8_t qos)
+{
+    size_t topicLen = strlen(topic);
+    if (!connected() || _streamOpen || qos > 1 || topicLen > 0xFFFF)
+        return false;
+    uint16_t id = _packetId();
+    uint8_t packetId[2] = {(uint8_t)(id >> 8), (uint8_t)id};
+    uint8_t noProperties = 0;
+    bool sent = _txBegin(kSubscribe, 2 + 2 + topicLen + 1 + (_version >= 5 ? 1 : 0)) &&
+                _txAppend(packetId, sizeof(packetId)) && _txAppend(&noProperties, _version >= 5 ? 1 : 0) &&
+                _txString(topic) && _txAppend(&qos, 1) && _txFlush();
+    if (!sent)
+        _lost(MQTT_CONNECTION_LOST);
+    return sent;
+}
+
+bool DecentIoTMqtt::loop()
+{
+    if (!connected())
+        return false;
+    if (_streamOpen)
+        return true; // nothing may be written until endPublish()
+
+    unsigned long now = millis();
+    unsigned long interval = _keepAlive * 1000UL;
+    if (interval > 0 && (now - _lastIn > interval || now - _lastOut > interval))
+    {
+        if (_pingOutstanding)
+        {
+            _lost(MQTT_CONNECTION_TIMEOUT);
+            return false;
+        }
+        uint8_t ping[2] = {kPingreq, 0};
+        if (!_writeAll(ping, sizeof(ping)))
+        {
+            _lost(MQTT_CONNECTION_LOST);
+            return false;
+        }
+        _pingOutstanding = true;
+        _lastIn = now; // the broker gets one more interval to answer
+    }
+
+    if (_readPacket())
+    {
+        _lastIn = millis();
+        _pingOutstanding = false;
+        _handlePacket();
+    }
+    return _state == MQTT_CONNECTED;
+}
+
+size_t DecentIoTMqtt::inflight() const
+{
+    size_t count = 0;
+    for (auto &slot : _inflight)
+        count += slot.id != 0;
+    return count;
+}
+
+// Never 0, and never one that is still waiting for its PUBACK
+uint16_t DecentIoTMqtt::_packetId()
+{
+    for (;;)
+    {
+        uint16_t id = _nextPacketId++;
+        if (_nextPacketId == 0)
+            _nextPacketId = 1;
+        bool used = false;
+        for (auto &slot : _inflight)
+            used |= slot.id == id;
+        if (!used)
+            return id;
+    }
+}
+
+bool DecentIoTMqtt::_txBegin(uint8_t header, uint32_t remaining)
+{
+    uint8_t fixed[5];
+    fixed[0] = header;
+    size_t n = 1 + encodeLength(remaining, fixed + 1);
+    _txLen = 0;
+    _txFailed = false;
+    return _txAppend(fixed, n);
+}
+
+// Small pieces are gathered in _tx; anything that does not fit is written
+// through after flushing what was gathered
+bool DecentIoTMqtt::_txAppend(const void *data, size_t size)
+{
+    if (_txFailed)
+        return false;
+    if (_txLen + size <= sizeof(_tx))
+    {
+        memcpy(_tx + _txLen, data, size);
+        _txLen += size;
+        return true;
+    }
+    if (!_txFlush())
+        return false;
+    if (size >= sizeof(_tx))
+        return _writeAll(static_cast<const uint8_t *>(data), size);
+    memcpy(_tx, data, size);
+    _txLen = size;
+    return true;
+}
+
+bool DecentIoTMqtt::_txString(const char *text)
+{
+    size_t len = strlen(text);
+    uint8_t prefix[2] = {(uint8_t)(len >> 8), (uint8_t)len};
+    return _txAppend(prefix, sizeof(prefix)) && _txAppend(text, len);
+}
+
+bool DecentIoTMqtt::_txFlush()
+{
+    bool ok = _txLen == 0 ? !_txFailed : _writeAll(_tx, _txLen);
+    _txLen = 0;
+    return ok;
+}
+
+bool DecentIoTMqtt::_writeAll(const uint8_t *data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t n = _transport->write(data, size);
+        if (n == 0)
+        {
+            _txFailed = true;
+            return false;
+        }
+        data += n;
+        size -= n;
+        _bytesSent += n;
+    }
+    _lastOut = millis();
+    return true;
+}
+
+// Sized to the packet being received: powers of two from 64 bytes, capped at
+// setBufferSize(). The buffer is kept for the next packet.
+bool DecentIoTMqtt::_rxReserve(size_t size)
+{
+    if (size <= _rxCapacity)
+        return true;
+    if (size > _maxPacket)
+        return false;
+    size_t capacity = _rxCapacity > 0 ? _rxCapacity : 64;
+    while (capacity < size)
+        capacity *= 2;
+    if (capacity > _maxPacket)
+        capacity = _maxPacket;
+    delete[] _rxBuf;
+    _rxBuf = new uint8_t[capacity];
+    _rxCapacity = capacity;
+    return true;
+}
+
+// Consumes whatever the transport has; true once a whole packet is in
+// _rxBuf. Partial packets carry over to the next call.
+bool DecentIoTMqtt::_readPacket()
+{
+    while (_transport->available() > 0)
+    {
+        switch (_rxState)
+        {
+        case RX_HEADER:
+            if (_transport->read(&_rxHeader, 1) != 1)
+                return false;
+            _rxLength = 0;
+            _rxShift = 0;
+            _rxState = RX_LENGTH;
+            break;
+
+        case RX_LENGTH:
+        {
+            uint8_t digit;
+            if (_transport->read(&digit, 1) != 1)
+                return false;
+            _rxLength |= (uint32_t)(digit & 0x7F) << _rxShift;
+            _rxShift += 7;
+            if (digit & 0x80)
+            {
+                if (_rxShift >= 28)
+                {
+                    _lost(MQTT_CONNECTION_LOST); // malformed length
+                    return false;
+                }
+                break;
+            }
+            _rxPos = 0;
+            if (_rxLength == 0)
+            {
+                _rxState = RX_HEADER;
+                return true;
+            }
+            if (_rxReserve(_rxLength))
+            {
+                _rxState = RX_BODY;
+            }
+            else if ((_rxHeader & 0xF0) == kPublish && _streamCallback && _rxReserve(_maxPacket))
+            {
+                _rxState = RX_STREAM_HEAD;
+            }
+            else
+            {
+                _dropped++;
+                _rxState = RX_SKIP;
+            }
+            break;
+        }
+
+        case RX_BODY:
+        {
+            int n = _transport->read(_rxBuf + _rxPos, _rxLength - _rxPos);
+            if (n <= 0)
+                return false;
+            _rxPos += n;
+            if (_rxPos == _rxLength)
+            {
+                _rxState = RX_HEADER;
+                return true;
+            }
+            break;
+        }
+
+        case RX_STREAM_HEAD:
+        {
+            size_t room = _rxCapacity - _rxPos;
+            size_t want = _rxLength - _rxPos < room ? _rxLength - _rxPos : room;
+            int n = _transport->read(_rxBuf + _rxPos, want);
+            if (n <= 0)
+                return false;
+            _rxPos += n;
+            int started = _streamStart();
+            if (started < 0 || (started == 0 && _rxPos == _rxCapacity))
+            {
+                // Not a PUBLISH we can take, or a topic longer than the buffer
+                _dropped++;
+                _rxState = _rxPos == _rxLength ? RX_HEADER : RX_SKIP;
+            }
+            else if (started > 0 && _rxPos == _rxLength)
+            {
+                _rxState = RX_HEADER;
+                _rxStreamed = true;
+                return true;
+            }
+            break;
+        }
+
+        case RX_STREAM:
+        {
+            uint8_t *chunk = _rxBuf + _streamTopicLen + 1;
+            size_t room = _rxCapacity - _streamTopicLen - 1;
+            size_t want = _rxLength - _rxPos < room ? _rxLength - _rxPos : room;
+            int n = _transport->read(chunk, want);
+            if (n <= 0)
+                return false;
+            _rxPos += n;
+            _streamChunk(chunk, n);
+            if (_rxPos == _rxLength)
+            {
+                _rxState = RX_HEADER;
+                _rxStreamed = true;
+                return true;
+            }
+            break;
+        }
+
+        case RX_SKIP:
+        {
+            uint8_t scratch[32];
+            size_t want = _rxLength - _rxPos < sizeof(scratch) ? _rxLength - _rxPos : sizeof(scratch);
+            int n = _transport->read(scratch, want);
+            if (n <= 0)
+                return false;
+            _rxPos += n;
+            if (_rxPos == _rxLength)
+                _rxState = RX_HEADER;
+            break;
+        }
+        }
+    }
+    return false;
+}
+
+// Parses the head of a streamed PUBLISH once enough of it is in _rxBuf:
+// 1 = started (payload bytes read so far delivered), 0 = need more, -1 = invalid
+int DecentIoTMqtt::_streamStart()
+{
+    uint8_t qos = (_rxHeader >> 1) & 0x03;
+    if (qos > 1)
+        return -1;
+    if (_rxPos < 2)
+        return 0;
+    size_t topicLen = ((size_t)_rxBuf[0] << 8) | _rxBuf[1];
+    size_t head = 2 + topicLen + (qos ? 2 : 0);
+    if (head > _rxLength)
+        return -1;
+    if (_rxPos < head)
+        return 0;
+    _streamId = qos ? ((uint16_t)_rxBuf[2 + topicLen] << 8) | _rxBuf[3 + topicLen] : 0;
+    if (_version >= 5)
+    {
+        const uint8_t *p = _rxBuf + head;
+        uint32_t propertiesLen;
+        if (!_readVarInt(p, _rxBuf + _rxPos, propertiesLen))
+            return _rxPos - head >= 4 ? -1 : 0;
+        head = (p - _rxBuf) + propertiesLen;
+        if (head > _rxLength)
+            return -1;
+        if (_rxPos < head)
+            return 0;
+    }
+
+    // Topic to the front, NUL-terminated; payload read so far right behind it
+    memmove(_rxBuf, _rxBuf + 2, topicLen);
+    _rxBuf[topicLen] = '\0';
+    memmove(_rxBuf + topicLen + 1, _rxBuf + head, _rxPos - head);
+    _streamTopicLen = topicLen;
+    _streamOffset = 0;
+    _streamTotal = _rxLength - head;
+    _rxState = RX_STREAM;
+    if (_rxPos > head)
+        _streamChunk(_rxBuf + topicLen + 1, _rxPos - head);
+    return 1;
+}
+
+void DecentIoTMqtt::_streamChunk(const uint8_t *data, size_t length)
+{
+    _streamCallback(reinterpret_cast<char *>(_rxBuf), data, length, _streamOffset, _streamTotal);
+    _streamOffset += length;
+}
+
+void DecentIoTMqtt::_handlePacket()
+{
+    if (_rxStreamed)
+    {
+        // Already delivered chunk by chunk
+        _rxStreamed = false;
+        if (_streamId != 0)
+        {
+            uint8_t ack[4] = {kPuback, 2, (uint8_t)(_streamId >> 8), (uint8_t)_streamId};
+            if (!_writeAll(ack, sizeof(ack)))
+                _lost(MQTT_CONNECTION_LOST);
+        }
+        return;
+    }
+    uint8_t type = _rxHeader & 0xF0;
+    if (type == kPublish)
+    {
+        uint8_t qos = (_rxHeader >> 1) & 0x03;
+        if (qos > 1 || _rxLength < 2)
+            return;
+        size_t topicLen = ((size_t)_rxBuf[0] << 8) | _rxBuf[1];
+        size_t offset = 2 + topicLen + (qos ? 2 : 0);
+        if (offset > _rxLength)
+            return;
+        if (_version >= 5)
+        {
+            const uint8_t *p = _rxBuf + offset;
+            const uint8_t *end = _rxBuf + _rxLength;
+            uint32_t propertiesLen;
+            if (!_readVarInt(p, end, propertiesLen) || propertiesLen > (uint32_t)(end - p))
+                return;
+            offset = (p - _rxBuf) + propertiesLen;
+        }
+        uint16_t id = qos ? ((uint16_t)_rxBuf[2 + topicLen] << 8) | _rxBuf[3 + topicLen] : 0;
+        // Slide the topic over its length prefix to NUL-terminate it in place
+        memmove(_rxBuf, _rxBuf + 2, topicLen);
+        _rxBuf[topicLen] = '\0';
+        if (_callback)
+            _callback(reinterpret_cast<char *>(_rxBuf), _rxBuf + offset, _rxLength - offset);
+        if (qos == 1)
+        {
+            uint8_t ack[4] = {kPuback, 2, (uint8_t)(id >> 8), (uint8_t)id};
+            if (!_writeAll(ack, sizeof(ack)))
+                _lost(MQTT_CONNECTION_LOST);
+        }
+    }
+    else if (type == kPuback && _rxLength >= 2)
+    {
+        _releaseInflight(((uint16_t)_rxBuf[0] << 8) | _rxBuf[1]);
+    }
+    else if (type == kDisconnect)
+    {
+        _lost(MQTT_CONNECTION_LOST); // MQTT 5 brokers say why before closing
+    }
+    // SUBACK and PINGRESP need nothing beyond the activity update in loop()
+}
+
+// Unacknowledged QoS 1 publishes go out again, oldest first, flagged DUP.
+// Packets encoded for another protocol level cannot be, and are dropped.
+// Aliases belong to the old connection: a packet keeps its alias only if the
+// new CONNACK allows it (the full topic it carries registers it again), and
+// loses the property otherwise.
+void DecentIoTMqtt::_resendInflight()
+{
+    for (auto &slot : _inflight)
+    {
+        if (slot.id != 0 && slot.version != _version)
+            _releaseInflight(slot.id);
+        else if (slot.id != 0 && slot.alias > _aliasMax)
+            _dropAlias(slot);
+    }
+    uint32_t sentUpTo = 0;
+    bool first = true;
+    for (;;)
+    {
+        Inflight *next = nullptr;
+        for (auto &slot : _inflight)
+        {
+            if (slot.id != 0 && (first || slot.order > sentUpTo) && (next == nullptr || slot.order < next->order))
+                next = &slot;
+        }
+        if (next == nullptr)
+            return;
+        next->packet[0] |= kDupFlag;
+        if (!_writeAll(next->packet, next->length))
+        {
+            _lost(MQTT_CONNECTION_LOST);
+            return;
+        }
+        if (next->alias != 0)
+            _aliasSent |= 1ULL << (next->alias - 1);
+        sentUpTo = next->order;
+        first = false;
+    }
+}
+
+// Rewrites a stored packet without its Topic Alias property: the 4-byte
+// property list becomes an empty one, and the payload moves up behind it
+void DecentIoTMqtt::_dropAlias(Inflight &slot)
+{
+    uint8_t *packet = slot.packet;
+    const uint8_t *p = packet + 1;
+    uint32_t remaining;
+    if (!_readVarInt(p, packet + slot.length, remaining))
+        return;
+    size_t oldHeader = p - packet;
+    uint8_t lengthBytes[4];
+    size_t newHeader = 1 + encodeLength(remaining - 3, lengthBytes);
+    size_t beforeProperties = 2 + slot.topicLen + 2; // topic, packet id
+    size_t payload = remaining - beforeProperties - 4;
+
+    memmove(packet + newHeader, packet + oldHeader, beforeProperties);
+    memcpy(packet + 1, lengthBytes, newHeader - 1);
+    uint8_t *properties = packet + newHeader + beforeProperties;
+    memmove(properties + 1, packet + oldHeader + beforeProperties + 4, payload);
+    properties[0] = 0;
+    slot.length = newHeader + remaining - 3;
+    slot.alias = 0;
+}
+
+void DecentIoTMqtt::_releaseInflight(uint16_t id)
+{
+    for (auto &slot : _inflight)
+    {
+        if (slot.id == id)
+        {
+            slot.id = 0;
+            slot.length = 0;
+            return;
+        }
+    }
+}
+
+void DecentIoTMqtt::_lost(int state)
+{
+    _transport->stop();
+    _state = state;
+    _rxState = RX_HEADER;
+    _rxStreamed = false;
+    _streamOpen = false;
+    _streamLeft = 0;
+    _txLen = 0;
+}
@@ -0,0 +1,212 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <functional>
+#include "DecentIoTTransport.h"
+
+// Same values as PubSubClient::state(), so either client can sit behind DecentIoT
+#ifndef MQTT_CONNECTED
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_CONNECT_BAD_PROTOCOL 1
+#define MQTT_CONNECT_BAD_CLIENT_ID 2
+#define MQTT_CONNECT_UNAVAILABLE 3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED 5
+#endif
+
+// QoS 1 publishes that may wait for their PUBACK at the same time
+#ifndef DECENTIOT_MQTT_INFLIGHT
+#define DECENTIOT_MQTT_INFLIGHT 4
+#endif
+// Bytes kept per unacknowledged QoS 1 publish (whole encoded packet); larger
+// QoS 1 publishes are refused. Fixed slots, so QoS 1 never allocates.
+#ifndef DECENTIOT_MQTT_INFLIGHT_PACKET
+#define DECENTIOT_MQTT_INFLIGHT_PACKET 256
+#endif
+// Packet headers and small payloads are gathered here so a publish goes out
+// in one or two socket writes (one TLS record each) instead of many
+#ifndef DECENTIOT_MQTT_TX_CHUNK
+#define DECENTIOT_MQTT_TX_CHUNK 128
+#endif
+
+// MQTT 5 / 3.1.1 client with the subset of the PubSubClient API that
+// DecentIoT uses. PUBLISH packets are streamed to the transport straight from
+// the caller's topic and payload; only the receive buffer is sized to the
+// largest packet seen so far, up to setBufferSize().
+//
+// MQTT 5 is tried first on every connect(). A broker that refuses it is
+// asked again at 3.1.1 on a new socket within the same call; the next
+// connect() tries 5 again.
+class DecentIoTMqtt
+{
+public:
+    using Callback = std::function<void(char *topic, uint8_t *payload, unsigned int length)>;
+    using StreamCallback = std::function<void(char *topic, const uint8_t *data, size_t length, size_t offset, size_t total)>;
+
+    explicit DecentIoTMqtt(Client &client);
+    ~DecentIoTMqtt();
+    DecentIoTMqtt(const DecentIoTMqtt &) = delete;
+    DecentIoTMqtt &operator=(const DecentIoTMqtt &) = delete;
+
+    DecentIoTMqtt &setClient(Client &client); // socket of the built-in transport
+    DecentIoTMqtt &setTransport(DecentIoTTransport &transport);
+    DecentIoTTransport &transport() { return *_transport; }
+    DecentIoTMqtt &setServer(const char *host, uint16_t port);
+    DecentIoTMqtt &setCallback(Callback callback);
+    // Inbound PUBLISH packets too large for the buffer are handed over in
+    // buffer-sized chunks instead of being dropped
+    DecentIoTMqtt &setStreamCallback(StreamCallback callback);
+    DecentIoTMqtt &setKeepAlive(uint16_t seconds);
+    DecentIoTMqtt &setSocketTimeout(uint16_t seconds);
+    bool setBufferSize(uint16_t size); // largest inbound packet; outbound size is not limited
+    uint16_t getBufferSize() const { return _maxPacket; }
+    void setPublishQos(uint8_t qos);   // for publish(topic, payload, retained), 0 or 1
+    uint8_t getPublishQos() const { return _publishQos; }
+    // 5 (default; falls back to 3.1.1 for a connection when the broker
+    // refuses level 5, and tries 5 again on the next connect) or 4 = 3.1.1 only
+    void setProtocolVersion(uint8_t version);
+    uint8_t protocolVersion() const { return _version; }
+
+    bool connect(const char *id, const char *user, const char *pass);
+    bool connected();
+    void disconnect();
+    bool publish(const char *topic, const char *payload, bool retained = false);
+    // false for QoS 1 while DECENTIOT_MQTT_INFLIGHT publishes await their
+    // PUBACK, or if the packet exceeds DECENTIOT_MQTT_INFLIGHT_PACKET
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained, uint8_t qos = 0);
+    // With MQTT 5, alias 1..topicAliasMax() stands for topic: the first
+    // publish on a connection sends both, later ones only the 2-byte alias.
+    // The caller must always pair an alias with the same topic.
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained, uint8_t qos, uint16_t alias);
+    uint16_t topicAliasMax() const { return _aliasMax; } // from CONNACK, 0 = no aliases
+    uint32_t bytesSent() const { return _bytesSent; }
+    // Streamed QoS 0 publish with the PubSubClient calls: exactly length
+    // payload bytes must be written before endPublish(), which returns 1 on
+    // success. A short payload leaves the stream unusable and drops the
+    // connection.
+    bool beginPublish(const char *topic, unsigned int length, bool retained);
+    size_t write(uint8_t byte);
+    size_t write(const uint8_t *data, size_t size);
+    int endPublish();
+    bool subscribe(const char *topic, uint8_t qos = 0);
+    // Keep-alive plus at most one inbound packet, like PubSubClient::loop()
+    bool loop();
+    int state() const { return _state; }
+    size_t inflight() const;
+    uint32_t droppedPackets() const { return _dropped; } // inbound packets over the buffer size
+
+    // MQTT variable-length integer; writes 1..4 bytes and returns the count
+    static size_t encodeLength(uint32_t length, uint8_t *out);
+
+private:
+    enum RxState : uint8_t
+    {
+        RX_HEADER,
+        RX_LENGTH,
+        RX_BODY,
+        RX_SKIP,        // packet larger than the buffer, read and discarded
+        RX_STREAM_HEAD, // large PUBLISH: topic and properties, then...
+        RX_STREAM       // ...payload chunks straight to the stream callback
+    };
+    struct Inflight
+    {
+        uint16_t id = 0;     // 0 = free
+        size_t length = 0;
+        uint8_t packet[DECENTIOT_MQTT_INFLIGHT_PACKET]; // kept to resend after a reconnect
+        uint32_t order = 0;        // resend in the original order
+        uint8_t version = 0;       // encoded for this protocol level
+        uint16_t topicLen = 0;
+        uint16_t alias = 0;        // Topic Alias property in packet, 0 = none
+    };
+
+    DecentIoTClientTransport _clientTransport;
+    DecentIoTTransport *_transport;
+    const char *_host = nullptr;
+    uint16_t _port = 1883;
+    Callback _callback;
+    StreamCallback _streamCallback;
+    uint16_t _keepAlive = 15;
+    uint16_t _socketTimeout = 15;
+    uint8_t _publishQos = 0;
+    uint8_t _maxVersion = 5; // from setProtocolVersion()
+    uint8_t _version = 5;    // level of the current connection
+    int _state = MQTT_DISCONNECTED;
+    // Negotiated in CONNACK (MQTT 5 only)
+    uint16_t _aliasMax = 0;
+    uint64_t _aliasSent = 0; // bit n: alias n + 1 is known to the broker on this connection
+    uint16_t _sendQuota = DECENTIOT_MQTT_INFLIGHT;
+    uint32_t _bytesSent = 0;
+    uint16_t _nextPacketId = 1;
+    unsigned long _lastIn = 0;
+    unsigned long _lastOut = 0;
+    bool _pingOutstanding = false;
+
+    uint8_t _tx[DECENTIOT_MQTT_TX_CHUNK];
+    size_t _txLen = 0;
+    bool _txFailed = false;
+
+    RxState _rxState = RX_HEADER;
+    uint8_t _rxHeader = 0;
+    uint32_t _rxLength = 0;
+    uint8_t _rxShift = 0;
+    uint32_t _rxPos = 0;
+    uint8_t *_rxBuf = nullptr;
+    size_t _rxCapacity = 0;
+    uint16_t _maxPacket = 256;
+    uint32_t _dropped = 0;
+    // Outbound stream between beginPublish() and endPublish()
+    uint32_t _streamLeft = 0;
+    bool _streamOpen = false;
+    // Inbound stream: the topic stays NUL-terminated at the start of _rxBuf,
+    // chunks are read into the space behind it
+    size_t _streamTopicLen = 0;
+    uint32_t _streamOffset = 0;
+    uint32_t _streamTotal = 0;
+    uint16_t _streamId = 0; // QoS 1 packet id to acknowledge, 0 for QoS 0
+    bool _rxStreamed = false;
+
+    Inflight _inflight[DECENTIOT_MQTT_INFLIGHT];
+    uint32_t _inflightOrder = 0;
+
+    uint16_t _packetId();
+    bool _openTransport();
+    int _handshake(const char *id, const char *user, const char *pass);
+    void _readConnack();
+    static bool _readVarInt(const uint8_t *&p, const uint8_t *end, uint32_t &value);
+    static bool _skipProperty(uint8_t id, const uint8_t *&p, const uint8_t *end);
+    bool _txAppend(const void *data, size_t size);
+    bool _txString(const char *text);
+    bool _txFlush();
+    bool _writeAll(const uint8_t *data, size_t size);
+    bool _txBegin(uint8_t header, uint32_t remaining);
+    bool _rxReserve(size_t size);
+    bool _readPacket();
+    int _streamStart();
+    void _streamChunk(const uint8_t *data, size_t length);
+    void _handlePacket();
+    void _resendInflight();
+    void _dropAlias(Inflight &slot);
+    void _releaseInflight(uint16_t id);
+    void _lost(int state);
+};
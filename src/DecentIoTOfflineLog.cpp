@@ -0,0 +1,443 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTOfflineLog.h"
+
+#include <string.h>
+
+static const size_t kRecordSize = sizeof(DecentIoTLogRecord);
+
+static uint32_t segmentRecordsFor(uint32_t records)
+{
+    uint32_t perSegment = (records + DECENTIOT_LOG_SEGMENTS - 1) / DECENTIOT_LOG_SEGMENTS;
+    return perSegment > 0 ? perSegment : 1;
+}
+
+#if defined(ESP8266) || defined(ESP32)
+
+DecentIoTLittleFSStorage::DecentIoTLittleFSStorage(const char *path, uint32_t records)
+    : _path(path), _checkpointPath(String(path) + ".ack"),
+      _segmentRecords(segmentRecordsFor(records)), _readerSegment(-1)
+{
+}
+
+String DecentIoTLittleFSStorage::_segmentPath(uint8_t segment) const
+{
+    return _path + "." + String((unsigned int)segment);
+}
+
+bool DecentIoTLittleFSStorage::open()
+{
+    if (!LittleFS.begin())
+    {
+        Serial.println("[DecentIoT] LittleFS mount failed");
+        return false;
+    }
+    return true;
+}
+
+size_t DecentIoTLittleFSStorage::size(uint8_t segment)
+{
+    String path = _segmentPath(segment);
+    if (!LittleFS.exists(path))
+        return 0;
+    File f = LittleFS.open(path, "r");
+    size_t bytes = f ? f.size() : 0;
+    f.close();
+    return bytes;
+}
+
+bool DecentIoTLittleFSStorage::read(uint8_t segment, uint32_t offset, void *data, size_t length)
+{
+    if (_readerSegment != segment)
+    {
+        _reader.close();
+        _readerSegment = -1;
+        String path = _segmentPath(segment);
+        if (!LittleFS.exists(path))
+            return false;
+        _reader = LittleFS.open(path, "r");
+        if (!_reader)
+            return false;
+        _readerSegment = segment;
+    }
+    return _reader.seek(offset) && _reader.read((uint8_t *)data, length) == length;
+}
+
+bool DecentIoTLittleFSStorage::append(uint8_t segment, const void *data, size_t length)
+{
+    if (_readerSegment == segment)
+    {
+        // The reader would not see the new size
+        _reader.close();
+        _readerSegment = -1;
+    }
+    File f = LittleFS.open(_segmentPath(segment), "a");
+    if (!f)
+        return false;
+    bool ok = f.write((const uint8_t *)data, length) == length;
+    f.close();
+    return ok;
+}
+
+bool DecentIoTLittleFSStorage::erase(uint8_t segment)
+{
+    if (_readerSegment == segment)
+    {
+        _reader.close();
+        _readerSegment = -1;
+    }
+    String path = _segmentPath(segment);
+    return !LittleFS.exists(path) || LittleFS.remove(path);
+}
+
+bool DecentIoTLittleFSStorage::loadCheckpoint(uint32_t &seq)
+{
+    if (!LittleFS.exists(_checkpointPath))
+        return false;
+    File f = LittleFS.open(_checkpointPath, "r");
+    if (!f)
+        return false;
+    bool ok = f.read((uint8_t *)&seq, sizeof(seq)) == sizeof(seq);
+    f.close();
+    return ok;
+}
+
+bool DecentIoTLittleFSStorage::saveCheckpoint(uint32_t seq)
+{
+    File f = LittleFS.open(_checkpointPath, "w");
+    if (!f)
+        return false;
+    bool ok = f.write((const uint8_t *)&seq, sizeof(seq)) == sizeof(seq);
+    f.close();
+    return ok;
+}
+
+#else
+
+DecentIoTFileStorage::DecentIoTFileStorage(const char *path, uint32_t records)
+    : _path(path), _checkpointPath(String(path) + ".ack"),
+      _segmentRecords(segmentRecordsFor(records)), _reader(nullptr), _readerSegment(-1)
+{
+}
+
+DecentIoTFileStorage::~DecentIoTFileStorage()
+{
+    _closeReader();
+}
+
+String DecentIoTFileStorage::_segmentPath(uint8_t segment) const
+{
+    return _path + "." + String((unsigned int)segment);
+}
+
+void DecentIoTFileStorage::_closeReader()
+{
+    if (_reader != nullptr)
+        fclose(_reader);
+    _reader = nullptr;
+    _readerSegment = -1;
+}
+
+bool DecentIoTFileStorage::open()
+{
+    return true;
+}
+
+size_t DecentIoTFileStorage::size(uint8_t segment)
+{
+    FILE *f = fopen(_segmentPath(segment).c_str(), "rb");
+    if (f == nullptr)
+        return 0;
+    fseek(f, 0, SEEK_END);
+    long bytes = ftell(f);
+    fclose(f);
+    return bytes > 0 ? (size_t)bytes : 0;
+}
+
+bool DecentIoTFileStorage::read(uint8_t segment, uint32_t offset, void *data, size_t length)
+{
+    if (_readerSegment != segment)
+    {
+        _closeReader();
+        _reader = fopen(_segmentPath(segment).c_str(), "rb");
+        if (_reader == nullptr)
+            return false;
+        _readerSegment = segment;
+    }
+    return fseek(_reader, offset, SEEK_SET) == 0 && fread(data, 1, length, _reader) == length;
+}
+
+bool DecentIoTFileStorage::append(uint8_t segment, const void *data, size_t length)
+{
+    if (_readerSegment == segment)
+        _closeReader(); // the reader would not see the new size
+    FILE *f = fopen(_segmentPath(segment).c_str(), "ab");
+    if (f == nullptr)
+        return false;
+    bool ok = fwrite(data, 1, length, f) == length;
+    ok = fclose(f) == 0 && ok;
+    return ok;
+}
+
+bool DecentIoTFileStorage::erase(uint8_t segment)
+{
+    if (_readerSegment == segment)
+        _closeReader();
+    String path = _segmentPath(segment);
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == nullptr)
+        return true;
+    fclose(f);
+    return remove(path.c_str()) == 0;
+}
+
+bool DecentIoTFileStorage::loadCheckpoint(uint32_t &seq)
+{
+    FILE *f = fopen(_checkpointPath.c_str(), "rb");
+    if (f == nullptr)
+        return false;
+    bool ok = fread(&seq, 1, sizeof(seq), f) == sizeof(seq);
+    fclose(f);
+    return ok;
+}
+
+bool DecentIoTFileStorage::saveCheckpoint(uint32_t seq)
+{
+    FILE *f = fopen(_checkpointPath.c_str(), "wb");
+    if (f == nullptr)
+        return false;
+    bool ok = fwrite(&seq, 1, sizeof(seq), f) == sizeof(seq);
+    fclose(f);
+    return ok;
+}
+
+#endif
+
+DecentIoTOfflineLog::DecentIoTOfflineLog()
+    : _storage(nullptr), _segments(0), _segmentRecords(0), _nextSeq(1), _tailSeq(1),
+      _savedSeq(1), _overwritten(0), _stagedCount(0)
+{
+}
+
+bool DecentIoTOfflineLog::begin(DecentIoTLogStorage *storage)
+{
+    _storage = nullptr;
+    if (storage == nullptr || storage->segments() == 0 || storage->segmentRecords() == 0 ||
+        !storage->open())
+        return false;
+    _storage = storage;
+    _segments = storage->segments();
+    _segmentRecords = storage->segmentRecords();
+    _stagedCount = 0;
+
+    // Every segment file starts on a segment boundary; find the oldest and
+    // newest, and drop files that hold something else
+    uint32_t oldest = 0;
+    uint32_t newest = 0;
+    for (uint8_t slot = 0; slot < _segments; slot++)
+    {
+        if (storage->size(slot) == 0)
+            continue;
+        DecentIoTLogRecord record;
+        if (!storage->read(slot, 0, &record, kRecordSize) || record.check != _checksum(record) ||
+            record.seq == 0 || _offsetOf(record.seq) != 0 || _slotOf(record.seq) != slot)
+        {
+            storage->erase(slot);
+            continue;
+        }
+        if (oldest == 0 || record.seq < oldest)
+            oldest = record.seq;
+        if (record.seq > newest)
+            newest = record.seq;
+    }
+
+    // Appends continue after the last record of the newest segment
+    _nextSeq = 1;
+    if (newest != 0)
+    {
+        size_t bytes = storage->size(_slotOf(newest));
+        uint32_t count = bytes / kRecordSize;
+        DecentIoTLogRecord last;
+        if (bytes % kRecordSize == 0 && count <= _segmentRecords && _readRecord(newest + count - 1, last))
+            _nextSeq = newest + count;
+        else
+            // Torn append (power loss): later records would land at the
+            // wrong offsets, so carry on in a fresh segment
+            _nextSeq = newest + _segmentRecords;
+    }
+
+    // Everything after the checkpoint is unsent, minus segments rotated out
+    uint32_t saved = 1;
+    storage->loadCheckpoint(saved);
+    uint32_t tail = saved;
+    if (oldest == 0)
+        oldest = _nextSeq;
+    if (tail < oldest)
+        tail = oldest;
+    if (tail > _nextSeq)
+        tail = _nextSeq;
+    _tailSeq = tail;
+    _savedSeq = tail;
+    if (tail != saved)
+        storage->saveCheckpoint(tail); // a stale one could skip records appended from here
+
+    // Segments replayed before the reset but not yet deleted
+    for (uint32_t seq = oldest; _segmentOf(seq) < _segmentOf(tail); seq += _segmentRecords)
+        storage->erase(_slotOf(seq));
+    return true;
+}
+
+bool DecentIoTOfflineLog::append(uint8_t pin, uint8_t type, uint32_t timestamp, uint32_t value)
+{
+    if (_storage == nullptr)
+        return false;
+    if (_stagedCount == DECENTIOT_LOG_BATCH && !flush())
+        return false;
+
+    DecentIoTLogRecord &record = _staged[_stagedCount++];
+    record.seq = _nextSeq++;
+    record.timestamp = timestamp;
+    record.value = value;
+    record.pin = pin;
+    record.type = type;
+    record.check = _checksum(record);
+    if (_offsetOf(record.seq) == 0)
+        _startSegment(record.seq);
+    return true;
+}
+
+// A new segment takes the slot of the one _segments back. Whatever of that
+// segment was not replayed yet is lost.
+void DecentIoTOfflineLog::_startSegment(uint32_t seq)
+{
+    uint32_t kept = (uint32_t)(_segments - 1) * _segmentRecords;
+    if (seq <= kept)
+        return;
+    uint32_t survivor = seq - kept;
+    if (_tailSeq < survivor)
+    {
+        _overwritten += survivor - _tailSeq;
+        _tailSeq = survivor;
+    }
+}
+
+bool DecentIoTOfflineLog::flush()
+{
+    if (_storage == nullptr || _stagedCount == 0)
+        return true;
+
+    // One append per segment the staged records fall into
+    uint8_t start = 0;
+    while (start < _stagedCount)
+    {
+        uint32_t seq = _staged[start].seq;
+        uint8_t slot = _slotOf(seq);
+        uint32_t offset = _offsetOf(seq);
+        if (offset == 0)
+        {
+            if (!_storage->erase(slot))
+                break;
+        }
+        else if (_storage->size(slot) != offset)
+        {
+            // The segment does not end where this run starts (a failed
+            // append, or the file was lost); move on to the next segment
+            _restage(start);
+            continue;
+        }
+
+        uint8_t count = 1;
+        while (start + count < _stagedCount && _segmentOf(_staged[start + count].seq) == _segmentOf(seq))
+            count++;
+        if (!_storage->append(slot, &_staged[start], count * kRecordSize))
+            break;
+        start += count;
+    }
+
+    // Keep whatever was not written for the next attempt
+    memmove(_staged, _staged + start, (_stagedCount - start) * kRecordSize);
+    _stagedCount -= start;
+    return _stagedCount == 0;
+}
+
+void DecentIoTOfflineLog::_restage(uint8_t start)
+{
+    uint32_t seq = (_segmentOf(_staged[start].seq) + 1) * _segmentRecords + 1;
+    _startSegment(seq);
+    for (uint8_t i = start; i < _stagedCount; i++)
+    {
+        _staged[i].seq = seq++;
+        _staged[i].check = _checksum(_staged[i]);
+    }
+    _nextSeq = seq;
+}
+
+bool DecentIoTOfflineLog::peek(DecentIoTLogRecord &record)
+{
+    if (_storage == nullptr || size() == 0 || !flush())
+        return false;
+    while (size() > 0)
+    {
+        if (_readRecord(_tailSeq, record))
+            return true;
+        // Torn or missing record (e.g. power loss mid-write): skip it, or the
+        // rest of its segment if the file ends here
+        if (_storage->size(_slotOf(_tailSeq)) > _offsetOf(_tailSeq))
+        {
+            _tailSeq++;
+            continue;
+        }
+        uint32_t next = (_segmentOf(_tailSeq) + 1) * _segmentRecords + 1;
+        _tailSeq = next < _nextSeq ? next : _nextSeq;
+    }
+    return false;
+}
+
+void DecentIoTOfflineLog::pop()
+{
+    if (size() == 0)
+        return;
+    uint32_t consumed = _tailSeq++;
+    bool segmentDone = _segmentOf(consumed) != _segmentOf(_tailSeq);
+    if (segmentDone)
+        _storage->erase(_slotOf(consumed)); // replayed segments go whole
+    if (segmentDone || _tailSeq - _savedSeq >= DECENTIOT_LOG_CHECKPOINT_EVERY || size() == 0)
+    {
+        if (_storage->saveCheckpoint(_tailSeq))
+            _savedSeq = _tailSeq;
+    }
+}
+
+bool DecentIoTOfflineLog::_readRecord(uint32_t seq, DecentIoTLogRecord &record)
+{
+    return _storage->read(_slotOf(seq), _offsetOf(seq), &record, kRecordSize) &&
+           record.seq == seq && record.check == _checksum(record);
+}
+
+uint16_t DecentIoTOfflineLog::_checksum(const DecentIoTLogRecord &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (size_t i = 0; i < offsetof(DecentIoTLogRecord, check); i++)
+    {
+        sum1 = (sum1 + bytes[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return (sum2 << 8) | sum1;
+}
@@ -0,0 +1,161 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+
+#if defined(ESP8266) || defined(ESP32)
+#include <FS.h>
+#include <LittleFS.h>
+#else
+#include <stdio.h>
+#endif
+
+// Records staged in RAM before one append to flash
+#ifndef DECENTIOT_LOG_BATCH
+#define DECENTIOT_LOG_BATCH 8
+#endif
+// Consumed records between checkpoint writes (bounds replays after a reset)
+#ifndef DECENTIOT_LOG_CHECKPOINT_EVERY
+#define DECENTIOT_LOG_CHECKPOINT_EVERY 32
+#endif
+// Segment files the log is split into. Only the oldest one is dropped when
+// the log is full, so up to 1/DECENTIOT_LOG_SEGMENTS of it is lost at once.
+#ifndef DECENTIOT_LOG_SEGMENTS
+#define DECENTIOT_LOG_SEGMENTS 8
+#endif
+
+// Fixed 16-byte record. Record n lives in segment (n - 1) / segmentRecords,
+// at a fixed offset within it.
+struct DecentIoTLogRecord
+{
+    uint32_t seq;       // 1, 2, 3...
+    uint32_t timestamp; // epoch seconds, 0 if the clock was not set
+    uint32_t value;     // bool/int value, or float bits
+    uint8_t pin;        // pin index (P0..P50)
+    uint8_t type;       // DecentIoTValue::Type
+    uint16_t check;     // Fletcher-16 over the bytes above, detects torn writes
+};
+
+// Backing store for the offline log: a fixed set of segment files that are
+// only ever appended to, or deleted whole. Nothing is rewritten in place, so
+// flash wear is left to the filesystem's own allocator.
+class DecentIoTLogStorage
+{
+public:
+    virtual ~DecentIoTLogStorage() {}
+    virtual bool open() = 0;
+    virtual uint8_t segments() const = 0;        // segment files kept at most
+    virtual uint32_t segmentRecords() const = 0; // records per segment file
+    virtual size_t size(uint8_t segment) = 0;    // bytes stored, 0 if deleted
+    virtual bool read(uint8_t segment, uint32_t offset, void *data, size_t length) = 0;
+    virtual bool append(uint8_t segment, const void *data, size_t length) = 0;
+    virtual bool erase(uint8_t segment) = 0;
+    virtual bool loadCheckpoint(uint32_t &seq) = 0;
+    virtual bool saveCheckpoint(uint32_t seq) = 0;
+};
+
+#if defined(ESP8266) || defined(ESP32)
+// Segment files "<path>.0" ... "<path>.7" on LittleFS, plus a small side
+// file holding the checkpoint
+class DecentIoTLittleFSStorage : public DecentIoTLogStorage
+{
+public:
+    DecentIoTLittleFSStorage(const char *path, uint32_t records);
+    bool open() override;
+    uint8_t segments() const override { return DECENTIOT_LOG_SEGMENTS; }
+    uint32_t segmentRecords() const override { return _segmentRecords; }
+    size_t size(uint8_t segment) override;
+    bool read(uint8_t segment, uint32_t offset, void *data, size_t length) override;
+    bool append(uint8_t segment, const void *data, size_t length) override;
+    bool erase(uint8_t segment) override;
+    bool loadCheckpoint(uint32_t &seq) override;
+    bool saveCheckpoint(uint32_t seq) override;
+
+private:
+    String _segmentPath(uint8_t segment) const;
+
+    String _path;
+    String _checkpointPath;
+    uint32_t _segmentRecords;
+    File _reader;        // kept open while a segment is replayed
+    int _readerSegment;  // -1 = none
+};
+#else
+// Regular files, for running the log on a development host
+class DecentIoTFileStorage : public DecentIoTLogStorage
+{
+public:
+    DecentIoTFileStorage(const char *path, uint32_t records);
+    ~DecentIoTFileStorage();
+    bool open() override;
+    uint8_t segments() const override { return DECENTIOT_LOG_SEGMENTS; }
+    uint32_t segmentRecords() const override { return _segmentRecords; }
+    size_t size(uint8_t segment) override;
+    bool read(uint8_t segment, uint32_t offset, void *data, size_t length) override;
+    bool append(uint8_t segment, const void *data, size_t length) override;
+    bool erase(uint8_t segment) override;
+    bool loadCheckpoint(uint32_t &seq) override;
+    bool saveCheckpoint(uint32_t seq) override;
+
+private:
+    String _segmentPath(uint8_t segment) const;
+    void _closeReader();
+
+    String _path;
+    String _checkpointPath;
+    uint32_t _segmentRecords;
+    FILE *_reader;       // kept open while a segment is replayed
+    int _readerSegment;  // -1 = none
+};
+#endif
+
+// Append-only segmented log of pin values, replayed oldest first
+class DecentIoTOfflineLog
+{
+public:
+    DecentIoTOfflineLog();
+    bool begin(DecentIoTLogStorage *storage);
+    bool attached() const { return _storage != nullptr; }
+    bool append(uint8_t pin, uint8_t type, uint32_t timestamp, uint32_t value);
+    bool peek(DecentIoTLogRecord &record); // oldest record not yet consumed
+    void pop();                            // consume the record returned by peek()
+    bool flush();
+    uint32_t size() const { return _nextSeq - _tailSeq; }
+    uint32_t overwritten() const { return _overwritten; }
+
+private:
+    static uint16_t _checksum(const DecentIoTLogRecord &record);
+    uint32_t _segmentOf(uint32_t seq) const { return (seq - 1) / _segmentRecords; }
+    uint8_t _slotOf(uint32_t seq) const { return _segmentOf(seq) % _segments; }
+    uint32_t _offsetOf(uint32_t seq) const { return (seq - 1) % _segmentRecords * sizeof(DecentIoTLogRecord); }
+    bool _readRecord(uint32_t seq, DecentIoTLogRecord &record);
+    void _startSegment(uint32_t seq);
+    void _restage(uint8_t start);
+
+    DecentIoTLogStorage *_storage;
+    uint8_t _segments;
+    uint32_t _segmentRecords;
+    uint32_t _nextSeq;      // seq of the next appended record
+    uint32_t _tailSeq;      // oldest record not yet consumed
+    uint32_t _savedSeq;     // last checkpoint written to storage
+    uint32_t _overwritten;  // unsent records lost to rotation
+    DecentIoTLogRecord _staged[DECENTIOT_LOG_BATCH];
+    uint8_t _stagedCount;
+};
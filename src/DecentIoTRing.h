@@ -0,0 +1,143 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Code that may run from an interrupt must live in IRAM on the ESP chips
+#if defined(ESP32) || defined(ESP8266)
+#define DECENTIOT_ISR_ATTR IRAM_ATTR
+#else
+#define DECENTIOT_ISR_ATTR
+#endif
+
+// Bounded single-producer/single-consumer queue. Exactly one thread may
+// push and exactly one may pop; neither side ever blocks or allocates.
+// N must be a power of two. Head and tail run freely and wrap together.
+template <typename T, size_t N>
+class DecentIoTSpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    // False if the ring is full
+    bool push(const T &item)
+    {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) == N)
+            return false;
+        _items[head & (N - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // False if the ring is empty
+    bool pop(T &item)
+    {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire))
+            return false;
+        item = _items[tail & (N - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called while the other side is active
+    size_t size() const
+    {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<size_t> _head{0}; // written by the producer only
+    std::atomic<size_t> _tail{0}; // written by the consumer only
+    T _items[N];
+};
+
+// Bounded multi-producer/single-consumer queue (Vyukov's sequenced cells).
+// push() is lock-free and never waits on another producer, so it is safe
+// from ISRs and from any task; pop() belongs to a single consumer. A cell
+// claimed by a producer that was interrupted before finishing simply isn't
+// visible to pop() yet. N must be a power of two.
+template <typename T, size_t N>
+class DecentIoTMpscRing
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "ring size must be a power of two");
+
+public:
+    DecentIoTMpscRing()
+    {
+        for (size_t i = 0; i < N; i++)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // False if the ring is full
+    DECENTIOT_ISR_ATTR bool push(const T &item)
+    {
+        size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell &cell = _cells[pos & (N - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0)
+            {
+                // Free cell for this lap: claim it, then fill and publish it
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.item = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // the consumer has not freed this cell yet
+            }
+            else
+            {
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // False if empty, or if the oldest cell is still being written
+    bool pop(T &item)
+    {
+        Cell &cell = _cells[_dequeuePos & (N - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(_dequeuePos + 1) < 0)
+            return false;
+        item = cell.item;
+        cell.sequence.store(_dequeuePos + N, std::memory_order_release);
+        _dequeuePos++;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+    Cell _cells[N];
+    std::atomic<size_t> _enqueuePos{0};
+    size_t _dequeuePos = 0; // consumer only
+};
@@ -0,0 +1,230 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTSeries.h"
+
+static uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+static size_t putVarint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+void DecentIoTSeriesEncoder::reset()
+{
+    _length = HEADER_MAX;
+    _count = 0;
+    _type = INT;
+    _firstMillis = 0;
+    _lastMillis = 0;
+    _lastDelta = 0;
+    _lastValue = 0;
+}
+
+bool DecentIoTSeriesEncoder::add(uint32_t millis, int32_t value)
+{
+    if (!_begin(millis, INT))
+        return false;
+    _putVarint(zigzag(_count == 0 ? value : (int64_t)value - (int32_t)_lastValue));
+    _lastValue = (uint32_t)value;
+    _count++;
+    return true;
+}
+
+bool DecentIoTSeriesEncoder::add(uint32_t millis, float value)
+{
+    if (!_begin(millis, FLOAT))
+        return false;
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    if (_count == 0)
+    {
+        for (int i = 0; i < 4; i++)
+            _buffer[_length++] = (uint8_t)(bits >> (8 * i));
+    }
+    else
+    {
+        // Neighbouring samples share sign, exponent and the top of the
+        // mantissa, so the XOR is a short run of bits
+        uint32_t x = bits ^ _lastValue;
+        if (x == 0)
+        {
+            _putVarint(0);
+        }
+        else
+        {
+            uint32_t tz = 0;
+            while ((x & (1UL << tz)) == 0)
+                tz++;
+            _putVarint(((uint64_t)(x >> tz) << 5) | tz);
+        }
+    }
+    _lastValue = bits;
+    _count++;
+    return true;
+}
+
+// Room check plus the timestamp of every sample after the first, which is
+// the block's base timestamp
+bool DecentIoTSeriesEncoder::_begin(uint32_t millis, Type type)
+{
+    if (_count == UINT16_MAX || _length + SAMPLE_MAX > sizeof(_buffer))
+        return false;
+    if (_count == 0)
+    {
+        _type = type;
+        _firstMillis = millis;
+        _lastMillis = millis;
+        _lastDelta = 0;
+        return true;
+    }
+    if (type != _type)
+        return false;
+    int32_t delta = (int32_t)(millis - _lastMillis);
+    _putVarint(zigzag((int64_t)delta - _lastDelta));
+    _lastDelta = delta;
+    _lastMillis = millis;
+    return true;
+}
+
+void DecentIoTSeriesEncoder::_putVarint(uint64_t value)
+{
+    _length += putVarint(_buffer + _length, value);
+}
+
+const uint8_t *DecentIoTSeriesEncoder::finish(uint64_t baseMillis, bool epoch, size_t &length)
+{
+    // Built at the end of the space reserved for it, right before sample 0
+    uint8_t header[HEADER_MAX];
+    size_t n = 0;
+    header[n++] = _type | (epoch ? 0x80 : 0);
+    n += putVarint(header + n, _count);
+    n += putVarint(header + n, baseMillis);
+    uint8_t *start = _buffer + HEADER_MAX - n;
+    memcpy(start, header, n);
+    length = _length - (HEADER_MAX - n);
+    return start;
+}
+
+bool DecentIoTSeriesReader::begin(const uint8_t *data, size_t length)
+{
+    _pos = data;
+    _end = data + length;
+    _read = 0;
+    _delta = 0;
+    _value = 0;
+    _count = 0;
+    if (length == 0 || (data[0] & 0x7F) > DecentIoTSeriesEncoder::FLOAT)
+        return false;
+    _type = (DecentIoTSeriesEncoder::Type)(data[0] & 0x7F);
+    _epoch = (data[0] & 0x80) != 0;
+    _pos++;
+    uint64_t count;
+    if (!_getVarint(count) || count > UINT16_MAX || !_getVarint(_timestamp))
+        return false;
+    _count = count;
+    return true;
+}
+
+bool DecentIoTSeriesReader::next(uint64_t &timestamp, int32_t &value)
+{
+    uint32_t raw;
+    if (_type != DecentIoTSeriesEncoder::INT || !_next(timestamp, raw))
+        return false;
+    value = (int32_t)raw;
+    return true;
+}
+
+bool DecentIoTSeriesReader::next(uint64_t &timestamp, float &value)
+{
+    uint32_t raw;
+    if (_type != DecentIoTSeriesEncoder::FLOAT || !_next(timestamp, raw))
+        return false;
+    memcpy(&value, &raw, sizeof(value));
+    return true;
+}
+
+bool DecentIoTSeriesReader::_next(uint64_t &timestamp, uint32_t &value)
+{
+    if (_read == _count)
+        return false;
+    uint64_t encoded;
+    if (_read > 0)
+    {
+        if (!_getVarint(encoded))
+            return false;
+        _delta += unzigzag(encoded);
+        _timestamp += _delta;
+    }
+
+    if (_read == 0 && _type == DecentIoTSeriesEncoder::FLOAT)
+    {
+        if (_end - _pos < 4)
+            return false;
+        _value = (uint32_t)_pos[0] | (uint32_t)_pos[1] << 8 | (uint32_t)_pos[2] << 16 | (uint32_t)_pos[3] << 24;
+        _pos += 4;
+    }
+    else
+    {
+        if (!_getVarint(encoded))
+            return false;
+        if (_type == DecentIoTSeriesEncoder::INT)
+        {
+            int64_t delta = unzigzag(encoded);
+            _value = (uint32_t)(_read == 0 ? delta : (int64_t)(int32_t)_value + delta);
+        }
+        else if (encoded != 0)
+        {
+            uint32_t tz = encoded & 31;
+            if ((encoded >> 5) > (UINT32_MAX >> tz))
+                return false;
+            _value ^= (uint32_t)(encoded >> 5) << tz;
+        }
+    }
+    _read++;
+    timestamp = _timestamp;
+    value = _value;
+    return true;
+}
+
+bool DecentIoTSeriesReader::_getVarint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && _pos < _end; shift += 7)
+    {
+        uint8_t byte = *_pos++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
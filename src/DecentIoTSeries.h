@@ -0,0 +1,102 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+
+// Encoded sample bytes per block, header not included
+#ifndef DECENTIOT_SERIES_BLOCK_SIZE
+#define DECENTIOT_SERIES_BLOCK_SIZE 256
+#endif
+
+// Block of timestamped samples of one pin. Integers are LEB128 varints,
+// signed ones zigzag-mapped first:
+//   header    type (0 = int, 1 = float), +0x80 if base is epoch ms rather
+//             than millis() since boot; sample count; base timestamp (ms)
+//   sample 0  value: int as varint, float as 4 bytes little-endian
+//   sample n  timestamp as delta-of-delta, then the value as
+//             int:   value - previous value
+//             float: x = bits ^ previous bits, written as 0 if x == 0,
+//                    else (x >> tz) << 5 | tz, tz = trailing zero bits of x
+// A steady sample rate and a slowly moving value cost 2-3 bytes per sample.
+class DecentIoTSeriesEncoder
+{
+public:
+    enum Type : uint8_t
+    {
+        INT = 0,
+        FLOAT = 1
+    };
+    static const size_t HEADER_MAX = 1 + 3 + 10; // type, count, base
+    static const size_t SAMPLE_MAX = 5 + 6;      // worst-case timestamp + float
+
+    DecentIoTSeriesEncoder() { reset(); }
+    void reset();
+    uint16_t count() const { return _count; }
+    Type type() const { return _type; }
+    uint32_t firstMillis() const { return _firstMillis; }
+    size_t size() const { return _length - HEADER_MAX; }
+    // false if the block is full or holds the other type
+    bool add(uint32_t millis, int32_t value);
+    bool add(uint32_t millis, float value);
+    // Puts the header in front of the samples; the block stays valid until
+    // the next add() or reset()
+    const uint8_t *finish(uint64_t baseMillis, bool epoch, size_t &length);
+
+private:
+    bool _begin(uint32_t millis, Type type);
+    void _putVarint(uint64_t value);
+
+    uint8_t _buffer[HEADER_MAX + DECENTIOT_SERIES_BLOCK_SIZE];
+    size_t _length;
+    uint16_t _count;
+    Type _type;
+    uint32_t _firstMillis;
+    uint32_t _lastMillis;
+    int32_t _lastDelta;
+    uint32_t _lastValue; // int value or float bits
+};
+
+// Walks the samples of a block made by DecentIoTSeriesEncoder
+class DecentIoTSeriesReader
+{
+public:
+    // false if data does not start with a valid header
+    bool begin(const uint8_t *data, size_t length);
+    DecentIoTSeriesEncoder::Type type() const { return _type; }
+    bool epoch() const { return _epoch; }
+    uint16_t count() const { return _count; }
+    // false once all samples are read, or on a truncated block
+    bool next(uint64_t &timestamp, int32_t &value);
+    bool next(uint64_t &timestamp, float &value);
+
+private:
+    bool _next(uint64_t &timestamp, uint32_t &value);
+    bool _getVarint(uint64_t &value);
+
+    const uint8_t *_pos = nullptr;
+    const uint8_t *_end = nullptr;
+    DecentIoTSeriesEncoder::Type _type = DecentIoTSeriesEncoder::INT;
+    bool _epoch = false;
+    uint16_t _count = 0;
+    uint16_t _read = 0;
+    uint64_t _timestamp = 0;
+    int64_t _delta = 0;
+    uint32_t _value = 0;
+};
@@ -0,0 +1,94 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+// Building blocks for the heap-free configuration (DECENTIOT_STATIC).
+// Both must be set for the library and the sketch alike, so define
+// DECENTIOT_MAX_PINS / DECENTIOT_MAX_TASKS as build flags, not in the sketch.
+
+#include <stddef.h>
+#include <type_traits>
+#include <utility>
+
+// Fixed-capacity stand-in for the parts of std::vector the library uses.
+// push_back() on a full list is ignored; callers check max_size() first.
+template <typename T, size_t N>
+class DecentIoTFixedVector
+{
+public:
+    DecentIoTFixedVector() : _size(0) {}
+
+    size_t size() const { return _size; }
+    size_t max_size() const { return N; }
+    bool empty() const { return _size == 0; }
+    void clear() { _size = 0; }
+
+    void push_back(const T &item)
+    {
+        if (_size < N)
+            _items[_size++] = item;
+    }
+    void pop_back()
+    {
+        if (_size > 0)
+            _items[--_size] = T();
+    }
+
+    T &back() { return _items[_size - 1]; }
+    T &operator[](size_t i) { return _items[i]; }
+    const T &operator[](size_t i) const { return _items[i]; }
+    T *begin() { return _items; }
+    T *end() { return _items + _size; }
+    const T *begin() const { return _items; }
+    const T *end() const { return _items + _size; }
+
+private:
+    T _items[N];
+    size_t _size;
+};
+
+// Callback that never allocates: a plain function pointer (including
+// capture-less lambdas), or a function pointer plus a context pointer.
+template <typename... Args>
+class DecentIoTStaticCallback
+{
+public:
+    using Function = void (*)(Args...);
+    using ContextFunction = void (*)(void *context, Args...);
+
+    DecentIoTStaticCallback() : _function(nullptr), _contextFunction(nullptr), _context(nullptr) {}
+    DecentIoTStaticCallback(std::nullptr_t) : DecentIoTStaticCallback() {}
+    template <typename F, typename = typename std::enable_if<std::is_convertible<F, Function>::value>::type>
+    DecentIoTStaticCallback(F function) : _function(function), _contextFunction(nullptr), _context(nullptr) {}
+    DecentIoTStaticCallback(ContextFunction function, void *context)
+        : _function(nullptr), _contextFunction(function), _context(context) {}
+
+    void operator()(Args... args) const
+    {
+        if (_contextFunction != nullptr)
+            _contextFunction(_context, std::forward<Args>(args)...);
+        else if (_function != nullptr)
+            _function(std::forward<Args>(args)...);
+    }
+    explicit operator bool() const { return _function != nullptr || _contextFunction != nullptr; }
+
+private:
+    Function _function;
+    ContextFunction _contextFunction;
+    void *_context;
+};
@@ -0,0 +1,124 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#include "DecentIoTThread.h"
+
+#if !defined(ESP32) && !defined(ESP8266)
+#include <chrono>
+#endif
+
+void DecentIoTThread::_trampoline(void *self)
+{
+    DecentIoTThread *thread = static_cast<DecentIoTThread *>(self);
+#if defined(ESP32)
+    thread->_self.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+#elif !defined(ESP8266)
+    thread->_self.store(std::this_thread::get_id(), std::memory_order_release);
+#endif
+    thread->_entry(thread->_arg);
+#if defined(ESP32)
+    thread->_self.store(nullptr, std::memory_order_release);
+#elif !defined(ESP8266)
+    thread->_self.store(std::thread::id(), std::memory_order_release);
+#endif
+    thread->_running.store(false, std::memory_order_release);
+#if defined(ESP32)
+    // FreeRTOS tasks must not return
+    vTaskDelete(nullptr);
+#endif
+}
+
+#if defined(ESP32)
+
+bool DecentIoTThread::start(Entry entry, void *arg, const char *name, uint32_t stackSize, int core)
+{
+    if (running())
+        return false;
+    _entry = entry;
+    _arg = arg;
+    _running.store(true, std::memory_order_release);
+    if (xTaskCreatePinnedToCore(_trampoline, name, stackSize, this, 1, &_handle, core) != pdPASS)
+    {
+        _running.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void DecentIoTThread::join()
+{
+    while (running())
+        sleep(1);
+    _handle = nullptr;
+}
+
+bool DecentIoTThread::isCurrent() const
+{
+    return _self.load(std::memory_order_acquire) == xTaskGetCurrentTaskHandle();
+}
+
+void DecentIoTThread::sleep(uint32_t ms)
+{
+    vTaskDelay(ms / portTICK_PERIOD_MS > 0 ? ms / portTICK_PERIOD_MS : 1);
+}
+
+#elif defined(ESP8266)
+
+bool DecentIoTThread::start(Entry, void *, const char *, uint32_t, int)
+{
+    return false;
+}
+
+void DecentIoTThread::join() {}
+
+bool DecentIoTThread::isCurrent() const
+{
+    return false;
+}
+
+void DecentIoTThread::sleep(uint32_t) {}
+
+#else
+
+bool DecentIoTThread::start(Entry entry, void *arg, const char *, uint32_t, int)
+{
+    if (running() || _thread.joinable())
+        return false;
+    _entry = entry;
+    _arg = arg;
+    _running.store(true, std::memory_order_release);
+    _thread = std::thread(_trampoline, this);
+    return true;
+}
+
+void DecentIoTThread::join()
+{
+    if (_thread.joinable())
+        _thread.join();
+}
+
+bool DecentIoTThread::isCurrent() const
+{
+    return _self.load(std::memory_order_acquire) == std::this_thread::get_id();
+}
+
+void DecentIoTThread::sleep(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+#endif
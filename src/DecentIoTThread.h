@@ -0,0 +1,64 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+// Minimal thread wrapper for the network task: a pinned FreeRTOS task on
+// ESP32, std::thread on a host build. ESP8266 has no threads.
+
+#include <stdint.h>
+#include <atomic>
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif !defined(ESP8266)
+#include <thread>
+#endif
+
+class DecentIoTThread
+{
+public:
+    using Entry = void (*)(void *arg);
+
+    // core is only honoured on ESP32; false if the thread could not start
+    bool start(Entry entry, void *arg, const char *name, uint32_t stackSize, int core);
+    // Waits for entry() to return; the caller must first make it return
+    void join();
+    bool running() const { return _running.load(std::memory_order_acquire); }
+    // True when called from this thread
+    bool isCurrent() const;
+
+    static void sleep(uint32_t ms);
+
+private:
+    static void _trampoline(void *self);
+
+    Entry _entry = nullptr;
+    void *_arg = nullptr;
+    std::atomic<bool> _running{false};
+    // Identity of the running thread, stored by the thread itself before
+    // entry() runs: the handle start() gets back may arrive after the thread
+    // has already asked isCurrent()
+#if defined(ESP32)
+    TaskHandle_t _handle = nullptr;
+    std::atomic<TaskHandle_t> _self{nullptr};
+#elif !defined(ESP8266)
+    std::thread _thread;
+    std::atomic<std::thread::id> _self{std::thread::id()};
+#endif
+};
@@ -0,0 +1,119 @@
+/*
+  DecentIoT MQTT Library
+  Copyright 2025 MD Jannatul Nayem
+  
+  Licensed under the Apache License, Version 2.0 (the "License");
+  you may not use this file except in compliance with the License.
+  You may obtain a copy of the License at
+  
+      http://www.apache.org/licenses/LICENSE-2.0
+  
+  Unless required by applicable law or agreed to in writing, software
+  distributed under the License is distributed on an "AS IS" BASIS,
+  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  See the License for the specific language governing permissions and
+  limitations under the License.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <vector>
+
+// Byte stream under DecentIoTMqtt. The default wraps the WiFiClientSecure
+// socket; a custom one can carry MQTT over anything that moves bytes.
+class DecentIoTTransport
+{
+public:
+    virtual ~DecentIoTTransport() {}
+    virtual bool connect(const char *host, uint16_t port) = 0;
+    virtual bool connected() = 0;
+    virtual int available() = 0;
+    // Reads up to size bytes without waiting; returns the count, 0 if none
+    virtual int read(uint8_t *buffer, size_t size) = 0;
+    // Returns how many bytes were accepted, 0 on error
+    virtual size_t write(const uint8_t *data, size_t size) = 0;
+    virtual void stop() = 0;
+};
+
+// Any Arduino Client: WiFiClientSecure, WiFiClient, EthernetClient, ...
+class DecentIoTClientTransport : public DecentIoTTransport
+{
+public:
+    explicit DecentIoTClientTransport(Client &client) : _client(&client) {}
+    void setClient(Client &client) { _client = &client; }
+
+    bool connect(const char *host, uint16_t port) override { return _client->connect(host, port) == 1; }
+    bool connected() override { return _client->connected(); }
+    int available() override { return _client->available(); }
+    int read(uint8_t *buffer, size_t size) override
+    {
+        int n = _client->read(buffer, size);
+        return n > 0 ? n : 0;
+    }
+    size_t write(const uint8_t *data, size_t size) override { return _client->write(data, size); }
+    void stop() override { _client->stop(); }
+
+private:
+    Client *_client;
+};
+
+// In-memory transport for host builds: everything the client writes is kept
+// in sent(), and bytes given to inject() are what it reads next, so packets
+// can be checked, fuzzed and benchmarked without a socket or a broker
+class DecentIoTLoopbackTransport : public DecentIoTTransport
+{
+public:
+    // Bytes "from the broker", e.g. a CONNACK before connect()
+    void inject(const uint8_t *data, size_t size) { _rx.insert(_rx.end(), data, data + size); }
+    const std::vector<uint8_t> &sent() const { return _tx; }
+    void clearSent() { _tx.clear(); }
+    // false drops the connection and makes connect() fail
+    void setLinkUp(bool up)
+    {
+        _linkUp = up;
+        if (!up)
+            _connected = false;
+    }
+    // Accept at most n bytes per write() or read(), to exercise partial I/O (0 = no limit)
+    void setChunkLimit(size_t n) { _chunk = n; }
+
+    bool connect(const char *, uint16_t) override
+    {
+        _connected = _linkUp;
+        return _connected;
+    }
+    bool connected() override { return _connected; }
+    int available() override { return _connected ? (int)(_rx.size() - _rxPos) : 0; }
+    int read(uint8_t *buffer, size_t size) override
+    {
+        size_t n = _limit(size < (size_t)available() ? size : (size_t)available());
+        memcpy(buffer, _rx.data() + _rxPos, n);
+        _rxPos += n;
+        if (_rxPos == _rx.size())
+        {
+            _rx.clear();
+            _rxPos = 0;
+        }
+        return (int)n;
+    }
+    size_t write(const uint8_t *data, size_t size) override
+    {
+        if (!_connected)
+            return 0;
+        size_t n = _limit(size);
+        _tx.insert(_tx.end(), data, data + n);
+        return n;
+    }
+    void stop() override { _connected = false; }
+
+private:
+    size_t _limit(size_t n) const { return (_chunk > 0 && n > _chunk) ? _chunk : n; }
+    std::vector<uint8_t> _rx;
+    std::vector<uint8_t> _tx;
+    size_t _rxPos = 0;
+    size_t _chunk = 0;
+    bool _linkUp = true;
+    bool _connected = false;
+};